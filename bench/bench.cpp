@@ -0,0 +1,296 @@
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <ranges>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if !defined(_WIN32)
+  #include <sys/resource.h>
+#endif
+
+#include <benchmark/benchmark.h>
+#include <cpp-tree-sitter.h>
+
+#include "corpora.h"
+
+
+extern "C" {
+TSLanguage* tree_sitter_json();
+TSLanguage* tree_sitter_c();
+}
+
+
+namespace {
+
+struct Corpus {
+  std::string name;
+  ts::Language language;
+  // A field that commonly occurs in the grammar, for field access benchmarks.
+  std::string_view field;
+  std::string source;
+};
+
+
+std::string
+readFile(const std::filesystem::path& path) {
+  std::ifstream in{path, std::ios::binary};
+  std::ostringstream contents;
+  contents << in.rdbuf();
+  return contents.str();
+}
+
+
+// Peak resident set size of the process so far, in kilobytes.
+double
+getPeakRSS() {
+#if defined(_WIN32)
+  return 0;
+#else
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  #if defined(__APPLE__)
+    return static_cast<double>(usage.ru_maxrss) / 1024;
+  #else
+    return static_cast<double>(usage.ru_maxrss);
+  #endif
+#endif
+}
+
+
+void
+finish(benchmark::State& state, const Corpus& corpus) {
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations())
+                          * static_cast<int64_t>(corpus.source.size()));
+  state.counters["peak_rss_kb"] = getPeakRSS();
+}
+
+
+void
+parseString(benchmark::State& state, const Corpus& corpus) {
+  ts::Parser parser{corpus.language};
+  for (auto _ : state) {
+    ts::Tree tree = parser.parseString(corpus.source);
+    benchmark::DoNotOptimize(tree.getRootNode().impl);
+  }
+  finish(state, corpus);
+}
+
+
+size_t
+walkChildIterators(ts::Node node) {
+  size_t count = 1;
+  for (ts::Node child : ts::Children{node}) {
+    count += walkChildIterators(child);
+  }
+  return count;
+}
+
+
+void
+walkWithChildIterators(benchmark::State& state, const Corpus& corpus) {
+  ts::Parser parser{corpus.language};
+  ts::Tree tree = parser.parseString(corpus.source);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(walkChildIterators(tree.getRootNode()));
+  }
+  finish(state, corpus);
+}
+
+
+// Counts tree-sitter's allocations while installed with ts::setAllocator.
+size_t numAllocations = 0;
+
+void*
+countingMalloc(size_t size) {
+  ++numAllocations;
+  return std::malloc(size);
+}
+
+void*
+countingCalloc(size_t count, size_t size) {
+  ++numAllocations;
+  return std::calloc(count, size);
+}
+
+void*
+countingRealloc(void* pointer, size_t size) {
+  ++numAllocations;
+  return std::realloc(pointer, size);
+}
+
+
+// Returns the number of nodes with children, each of which gets one view.
+size_t
+walkChildrenReversed(ts::Node node) {
+  ts::Children children{node};
+  size_t views = children.empty() ? 0 : 1;
+  for (ts::Node child : children | std::views::reverse) {
+    views += walkChildrenReversed(child);
+  }
+  return views;
+}
+
+
+// Checks that reverse iteration creates one cursor per view rather than
+// one per child.
+void
+walkWithReversedChildren(benchmark::State& state, const Corpus& corpus) {
+  ts::Parser parser{corpus.language};
+  ts::Tree tree = parser.parseString(corpus.source);
+  ts::setAllocator(ts::Allocator{countingMalloc, countingCalloc, countingRealloc, std::free});
+  size_t allocations = 0;
+  size_t views = 0;
+  for (auto _ : state) {
+    numAllocations = 0;
+    views = walkChildrenReversed(tree.getRootNode());
+    allocations = numAllocations;
+  }
+  ts::setAllocator(ts::Allocator{});
+  if (allocations > views) {
+    state.SkipWithError("Reverse iteration allocated more than once per view");
+  }
+  finish(state, corpus);
+  state.counters["allocations_per_view"] =
+    views ? static_cast<double>(allocations) / static_cast<double>(views) : 0;
+}
+
+
+void
+walkWithPreorderRange(benchmark::State& state, const Corpus& corpus) {
+  ts::Parser parser{corpus.language};
+  ts::Tree tree = parser.parseString(corpus.source);
+  for (auto _ : state) {
+    size_t count = 0;
+    for (ts::Node node : ts::PreorderRange{tree.getRootNode()}) {
+      benchmark::DoNotOptimize(node.impl);
+      ++count;
+    }
+    benchmark::DoNotOptimize(count);
+  }
+  finish(state, corpus);
+}
+
+
+// The baseline that the wrappers should match.
+void
+walkWithRawCursor(benchmark::State& state, const Corpus& corpus) {
+  ts::Parser parser{corpus.language};
+  ts::Tree tree = parser.parseString(corpus.source);
+  for (auto _ : state) {
+    TSTreeCursor cursor = ts_tree_cursor_new(tree.getRootNode().impl);
+    size_t count = 1;
+    bool done = false;
+    while (!done) {
+      if (ts_tree_cursor_goto_first_child(&cursor)) {
+        ++count;
+        continue;
+      }
+      while (!ts_tree_cursor_goto_next_sibling(&cursor)) {
+        if (!ts_tree_cursor_goto_parent(&cursor)) {
+          done = true;
+          break;
+        }
+      }
+      count += done ? 0 : 1;
+    }
+    ts_tree_cursor_delete(&cursor);
+    benchmark::DoNotOptimize(count);
+  }
+  finish(state, corpus);
+}
+
+
+void
+childByFieldName(benchmark::State& state, const Corpus& corpus) {
+  ts::Parser parser{corpus.language};
+  ts::Tree tree = parser.parseString(corpus.source);
+  for (auto _ : state) {
+    for (ts::Node node : ts::PreorderRange{tree.getRootNode()}) {
+      benchmark::DoNotOptimize(node.getChildByFieldName(corpus.field).impl);
+    }
+  }
+  finish(state, corpus);
+}
+
+
+void
+childByFieldID(benchmark::State& state, const Corpus& corpus) {
+  ts::Parser parser{corpus.language};
+  ts::Tree tree = parser.parseString(corpus.source);
+  ts::FieldID field = corpus.language.getFieldIDForName(corpus.field);
+  for (auto _ : state) {
+    for (ts::Node node : ts::PreorderRange{tree.getRootNode()}) {
+      benchmark::DoNotOptimize(node.getChildByFieldID(field).impl);
+    }
+  }
+  finish(state, corpus);
+}
+
+
+void
+getSExpr(benchmark::State& state, const Corpus& corpus) {
+  ts::Parser parser{corpus.language};
+  ts::Tree tree = parser.parseString(corpus.source);
+  for (auto _ : state) {
+    auto sexpr = tree.getRootNode().getSExpr();
+    benchmark::DoNotOptimize(sexpr.get());
+  }
+  finish(state, corpus);
+}
+
+
+std::vector<Corpus>
+loadCorpora() {
+  std::vector<Corpus> corpora;
+  auto add = [&corpora](auto& paths, ts::Language language, std::string_view field) {
+    for (const char* path : paths) {
+      std::filesystem::path file{path};
+      if (std::filesystem::exists(file)) {
+        corpora.push_back(Corpus{file.parent_path().parent_path().filename().string()
+                                   + "/" + file.filename().string(),
+                                 language, field, readFile(file)});
+      }
+    }
+  };
+  add(JSON_CORPUS, tree_sitter_json(), "key");
+  add(C_CORPUS, tree_sitter_c(), "declarator");
+  return corpora;
+}
+
+}
+
+
+int
+main(int argc, char** argv) {
+  // Corpora must outlive the benchmarks that refer to them.
+  static const std::vector<Corpus> corpora = loadCorpora();
+
+  using Benchmark = void (*)(benchmark::State&, const Corpus&);
+  const std::pair<const char*, Benchmark> benchmarks[] = {
+    {"parseString", parseString},
+    {"walk/ChildIterator", walkWithChildIterators},
+    {"walk/ChildIterator/reverse", walkWithReversedChildren},
+    {"walk/PreorderRange", walkWithPreorderRange},
+    {"walk/TSTreeCursor", walkWithRawCursor},
+    {"getChildByFieldName", childByFieldName},
+    {"getChildByFieldID", childByFieldID},
+    {"getSExpr", getSExpr},
+  };
+  for (const auto& [name, run] : benchmarks) {
+    for (const Corpus& corpus : corpora) {
+      benchmark::RegisterBenchmark(std::string{name} + "/" + corpus.name,
+        [run = run, &corpus](benchmark::State& state) { run(state, corpus); }
+      )->Unit(benchmark::kMillisecond);
+    }
+  }
+
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
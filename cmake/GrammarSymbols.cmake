@@ -0,0 +1,104 @@
+# Generates a C++ header of typed symbol and field identifiers for a grammar.
+#
+# The identifiers are extracted from the enums in the grammar's generated
+# parser.c, so they match the ids that tree-sitter reports for nodes of that
+# grammar. The header defines, within `ts::grammars::<name>` (with `-`
+# replaced by `_`),
+# * `enum class Sym : ts::Symbol` with one enumerator per public symbol,
+# * `enum class Field : ts::FieldID` with one enumerator per field,
+# * the LANGUAGE_VERSION, SYMBOL_COUNT, ALIAS_COUNT, and FIELD_COUNT of the
+#   parser, and
+# * `isCompatible(ts::Language)`, which checks at runtime that a language
+#   was generated from the same parser as the header.
+#
+# Only public symbols, those that ts_symbol_map in parser.c maps to
+# themselves, get enumerators, as Node::getSymbol() reports the public symbol
+# of a node. Symbols that duplicate the name of an earlier symbol map to that
+# one instead, and auxiliary symbols never appear as nodes.
+function(generate_grammar_symbols NAME PARSER_SOURCE OUTPUT)
+  file(READ "${PARSER_SOURCE}" parser_text)
+  string(MAKE_C_IDENTIFIER "${NAME}" namespace)
+
+  foreach(define LANGUAGE_VERSION SYMBOL_COUNT ALIAS_COUNT FIELD_COUNT)
+    if ("${parser_text}" MATCHES "#define ${define} ([0-9]+)")
+      set(${define} "${CMAKE_MATCH_1}")
+    else()
+      message(FATAL_ERROR "${PARSER_SOURCE} does not define ${define}")
+    endif()
+  endforeach()
+
+  string(REGEX MATCHALL
+    "\n  (sym|anon_sym|alias_sym)_[A-Za-z0-9_]+ = [0-9]+,"
+    symbol_lines "${parser_text}")
+  foreach(line IN LISTS symbol_lines)
+    string(REGEX MATCH "([A-Za-z0-9_]+) = ([0-9]+)" unused "${line}")
+    set(symbol_value_${CMAKE_MATCH_1} "${CMAKE_MATCH_2}")
+  endforeach()
+
+  string(FIND "${parser_text}" "ts_symbol_map[] = {" map_start)
+  if (map_start EQUAL -1)
+    message(FATAL_ERROR "${PARSER_SOURCE} does not define ts_symbol_map")
+  endif()
+  string(SUBSTRING "${parser_text}" ${map_start} -1 map_text)
+  string(FIND "${map_text}" "};" map_end)
+  string(SUBSTRING "${map_text}" 0 ${map_end} map_text)
+
+  set(symbols "")
+  string(REGEX MATCHALL
+    "\\[[A-Za-z0-9_]+\\] = [A-Za-z0-9_]+,"
+    map_entries "${map_text}")
+  foreach(entry IN LISTS map_entries)
+    string(REGEX MATCH "\\[([A-Za-z0-9_]+)\\] = ([A-Za-z0-9_]+)," unused "${entry}")
+    set(symbol "${CMAKE_MATCH_1}")
+    if ("${symbol}" STREQUAL "${CMAKE_MATCH_2}" AND DEFINED symbol_value_${symbol})
+      string(APPEND symbols "  ${symbol} = ${symbol_value_${symbol}},\n")
+    endif()
+  endforeach()
+
+  set(fields "")
+  string(REGEX MATCHALL
+    "\n  field_[A-Za-z0-9_]+ = [0-9]+,"
+    field_lines "${parser_text}")
+  foreach(line IN LISTS field_lines)
+    string(STRIP "${line}" line)
+    string(APPEND fields "  ${line}\n")
+  endforeach()
+
+  string(TOUPPER "${namespace}" guard)
+  set(header "\
+// Generated by generate_grammar_symbols from ${NAME}'s parser.c. Do not edit.
+#ifndef ${guard}_SYMBOLS_H
+#define ${guard}_SYMBOLS_H
+
+#include <cpp-tree-sitter.h>
+
+namespace ts::grammars::${namespace} {
+
+inline constexpr ts::Version LANGUAGE_VERSION = ${LANGUAGE_VERSION};
+inline constexpr size_t SYMBOL_COUNT = ${SYMBOL_COUNT};
+inline constexpr size_t ALIAS_COUNT = ${ALIAS_COUNT};
+inline constexpr size_t FIELD_COUNT = ${FIELD_COUNT};
+
+enum class Sym : ts::Symbol {
+${symbols}};
+
+enum class Field : ts::FieldID {
+${fields}};
+
+// Checks that `language` was generated from the same parser as this header,
+// so that the identifiers above are valid for its nodes.
+[[nodiscard]] inline bool
+isCompatible(ts::Language language) {
+  return language.getVersion() == LANGUAGE_VERSION
+         && language.getNumSymbols() == SYMBOL_COUNT + ALIAS_COUNT
+         && language.getNumFields() == FIELD_COUNT;
+}
+
+}
+
+#endif
+")
+
+  # Only rewrite the header when it changes to avoid needless rebuilds.
+  file(CONFIGURE OUTPUT "${OUTPUT}" CONTENT "${header}" @ONLY)
+endfunction(generate_grammar_symbols)
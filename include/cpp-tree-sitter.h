@@ -1,9 +1,28 @@
 #ifndef CPP_TREE_SITTER_H
 #define CPP_TREE_SITTER_H
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
 #include <iterator>
 #include <memory>
+#include <memory_resource>
+#include <new>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <string>
 #include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 #include <tree_sitter/api.h>
 
@@ -19,11 +38,19 @@ namespace ts {
 /////////////////////////////////////////////////////////////////////////////
 
 
+namespace detail {
+
+// The free function matching the allocator that tree-sitter currently uses.
+inline std::atomic<void (*)(void*)> currentFree{std::free};
+
+}
+
+
 struct FreeHelper{
   template <typename T>
   void
   operator()(T* raw_pointer) const {
-    std::free(raw_pointer);
+    detail::currentFree.load(std::memory_order_relaxed)(raw_pointer);
   }
 };
 
@@ -36,6 +63,160 @@ struct Extent {
 };
 
 
+/////////////////////////////////////////////////////////////////////////////
+// Allocation.
+// tree-sitter allocates through a single process wide set of hooks. Memory
+// must always be released through the same hooks that allocated it, so the
+// allocator should be chosen before any tree-sitter objects are created and
+// left in place while any of them are alive.
+/////////////////////////////////////////////////////////////////////////////
+
+
+struct Allocator {
+  void* (*malloc)(size_t);
+  void* (*calloc)(size_t, size_t);
+  void* (*realloc)(void*, size_t);
+  void (*free)(void*);
+};
+
+
+// Routes all tree-sitter allocations through the given functions. Any null
+// function is replaced by the corresponding C library function.
+inline void
+setAllocator(const Allocator& allocator) {
+  ts_set_allocator(allocator.malloc,
+                   allocator.calloc,
+                   allocator.realloc,
+                   allocator.free);
+  detail::currentFree = allocator.free ? allocator.free : std::free;
+}
+
+
+namespace detail {
+
+// Memory resource hooks prefix every allocation with the resource that
+// provided it, so a block is always returned to its own resource even when it
+// is freed on another thread or while another resource is in scope.
+struct AllocationHeader {
+  std::pmr::memory_resource* resource;
+  size_t size;
+};
+
+inline constexpr size_t ALLOCATION_ALIGNMENT = alignof(std::max_align_t);
+inline constexpr size_t ALLOCATION_HEADER_SIZE =
+  (sizeof(AllocationHeader) + ALLOCATION_ALIGNMENT - 1)
+  / ALLOCATION_ALIGNMENT * ALLOCATION_ALIGNMENT;
+
+inline std::atomic<std::pmr::memory_resource*> defaultResource{nullptr};
+inline thread_local std::pmr::memory_resource* scopedResource = nullptr;
+
+inline AllocationHeader*
+getAllocationHeader(void* pointer) {
+  return static_cast<AllocationHeader*>(
+    static_cast<void*>(static_cast<std::byte*>(pointer) - ALLOCATION_HEADER_SIZE));
+}
+
+// tree-sitter cannot recover from failed allocations, and exceptions must not
+// unwind through C code, so these hooks are noexcept and a failed allocation
+// terminates, just as it does with tree-sitter's default allocator.
+inline void*
+allocateFrom(std::pmr::memory_resource* resource, size_t size) noexcept {
+  void* raw = resource->allocate(ALLOCATION_HEADER_SIZE + size,
+                                 ALLOCATION_ALIGNMENT);
+  ::new (raw) AllocationHeader{resource, size};
+  return static_cast<std::byte*>(raw) + ALLOCATION_HEADER_SIZE;
+}
+
+inline void*
+resourceMalloc(size_t size) noexcept {
+  std::pmr::memory_resource* resource = scopedResource;
+  if (!resource) {
+    resource = defaultResource.load(std::memory_order_relaxed);
+  }
+  return allocateFrom(resource, size);
+}
+
+inline void
+resourceFree(void* pointer) noexcept {
+  if (!pointer) {
+    return;
+  }
+  AllocationHeader* header = getAllocationHeader(pointer);
+  header->resource->deallocate(header,
+                               ALLOCATION_HEADER_SIZE + header->size,
+                               ALLOCATION_ALIGNMENT);
+}
+
+inline void*
+resourceCalloc(size_t count, size_t size) noexcept {
+  if (size != 0 && count > SIZE_MAX / size) {
+    return nullptr;
+  }
+  void* pointer = resourceMalloc(count * size);
+  std::memset(pointer, 0, count * size);
+  return pointer;
+}
+
+inline void*
+resourceRealloc(void* pointer, size_t size) noexcept {
+  if (!pointer) {
+    return resourceMalloc(size);
+  }
+  // Grow within the resource that owns the original block.
+  AllocationHeader* header = getAllocationHeader(pointer);
+  void* resized = allocateFrom(header->resource, size);
+  std::memcpy(resized, pointer, std::min(size, header->size));
+  resourceFree(pointer);
+  return resized;
+}
+
+}
+
+
+// Routes all tree-sitter allocations through `resource`, or through
+// std::pmr::get_default_resource() when `resource` is null. Individual
+// threads may temporarily substitute another resource with ScopedAllocator.
+inline void
+setAllocator(std::pmr::memory_resource* resource) {
+  detail::defaultResource = resource ? resource : std::pmr::get_default_resource();
+  setAllocator(Allocator{detail::resourceMalloc,
+                         detail::resourceCalloc,
+                         detail::resourceRealloc,
+                         detail::resourceFree});
+}
+
+
+// Makes tree-sitter allocations on the current thread come from `resource`
+// for the lifetime of the guard. This requires setAllocator to have been
+// called with a memory resource first. Everything allocated while the guard
+// is active must be destroyed before the resource is released. For a
+// monotonic arena, this makes the individual frees of a tree trivial and the
+// arena can then be discarded as a whole.
+//
+// Destroying the trees is not enough: a parser used within the guard keeps
+// state allocated during its parses, such as the pool of subtrees that it
+// reuses across parses, and would later reuse that memory after the arena is
+// gone. Any parser used within the guard must therefore be created and
+// destroyed within it, too. Pooled parsers (ParserPool) and the parsers of a
+// ParallelParser outlive any one guard and must not be used within one.
+class ScopedAllocator {
+public:
+  explicit ScopedAllocator(std::pmr::memory_resource* resource)
+    : previous{std::exchange(detail::scopedResource, resource)}
+      { }
+
+  ScopedAllocator(const ScopedAllocator& other) = delete;
+  ScopedAllocator& operator=(const ScopedAllocator& other) = delete;
+
+  ~ScopedAllocator() {
+    detail::scopedResource = previous;
+  }
+
+private:
+  std::pmr::memory_resource* previous;
+};
+
+
 /////////////////////////////////////////////////////////////////////////////
 // Aliases.
 // Create slightly stricter aliases for some of the core tree-sitter types.
@@ -47,10 +228,15 @@ using Point = TSPoint;
 
 using Symbol = uint16_t;
 
+using FieldID = uint16_t;
+
 using Version = uint32_t;
 
 using NodeID = uintptr_t;
 
+// Direct alias of { start_point, end_point: Point; start_byte, end_byte: uint32_t }
+using Range = TSRange;
+
 
 // For types that manage resources, create custom wrappers that ensure
 // clean-up. For types that can benefit from additional API discovery,
@@ -83,6 +269,26 @@ struct Language {
                                        isNamed);
   }
 
+  [[nodiscard]] size_t
+  getNumFields() const {
+    return ts_language_field_count(impl);
+  }
+
+  [[nodiscard]] std::string_view
+  getFieldNameForID(FieldID id) const {
+    const char* name = ts_language_field_name_for_id(impl, id);
+    return name ? name : std::string_view{};
+  }
+
+  // Returns 0 if the language has no field named `name`. Resolving a field
+  // once and then using its ID avoids repeated lookups by name.
+  [[nodiscard]] FieldID
+  getFieldIDForName(std::string_view name) const {
+    return ts_language_field_id_for_name(impl,
+                                         name.data(),
+                                         static_cast<uint32_t>(name.size()));
+  }
+
   [[nodiscard]] Version
   getVersion() const {
     return ts_language_version(impl);
@@ -92,7 +298,60 @@ struct Language {
 };
 
 
+// Describes a single edit to the source text of a tree so that the tree can
+// be updated before being reused for an incremental parse.
+struct InputEdit {
+  uint32_t startByte;
+  uint32_t oldEndByte;
+  uint32_t newEndByte;
+  Point startPoint;
+  Point oldEndPoint;
+  Point newEndPoint;
+};
+
+
+// An owning, contiguous collection of ranges allocated by tree-sitter.
+class Ranges {
+public:
+  using iterator = Range const*;
+
+  Ranges(Range* ranges, uint32_t count)
+    : impl{ranges},
+      count{count}
+      { }
+
+  [[nodiscard]] iterator begin() const { return impl.get(); }
+  [[nodiscard]] iterator end() const { return impl.get() + count; }
+  [[nodiscard]] size_t size() const { return count; }
+  [[nodiscard]] bool empty() const { return count == 0; }
+
+  [[nodiscard]] const Range&
+  operator[](size_t position) const {
+    return impl.get()[position];
+  }
+
+private:
+  std::unique_ptr<Range, FreeHelper> impl;
+  uint32_t count;
+};
+
+
 class Cursor;
+struct ErrorRange;
+
+// The commonly read attributes of a node, gathered together by
+// Node::getInfo().
+struct NodeInfo {
+  Symbol symbol;
+  bool isNamed;
+  bool isMissing;
+  bool isExtra;
+  bool hasError;
+  bool isError;
+  Range range;
+  uint32_t numChildren;
+  uint32_t numNamedChildren;
+};
 
 struct Node {
   explicit Node(TSNode node)
@@ -163,6 +422,12 @@ struct Node {
     return Node{ts_node_child(impl, position)};
   }
 
+  // Counts this node and all nodes below it.
+  [[nodiscard]] uint32_t
+  getNumDescendants() const {
+    return ts_node_descendant_count(impl);
+  }
+
   // Named children
 
   [[nodiscard]] uint32_t
@@ -189,6 +454,37 @@ struct Node {
                                             static_cast<uint32_t>(name.size()))};
   }
 
+  [[nodiscard]] Node
+  getChildByFieldID(FieldID id) const {
+    return Node{ts_node_child_by_field_id(impl, id)};
+  }
+
+  // Smallest descendants spanning a range
+
+  [[nodiscard]] Node
+  getDescendantForByteRange(Extent<uint32_t> range) const {
+    return Node{ts_node_descendant_for_byte_range(impl, range.start, range.end)};
+  }
+
+  [[nodiscard]] Node
+  getNamedDescendantForByteRange(Extent<uint32_t> range) const {
+    return Node{
+      ts_node_named_descendant_for_byte_range(impl, range.start, range.end)
+    };
+  }
+
+  [[nodiscard]] Node
+  getDescendantForPointRange(Extent<Point> range) const {
+    return Node{ts_node_descendant_for_point_range(impl, range.start, range.end)};
+  }
+
+  [[nodiscard]] Node
+  getNamedDescendantForPointRange(Extent<Point> range) const {
+    return Node{
+      ts_node_named_descendant_for_point_range(impl, range.start, range.end)
+    };
+  }
+
   // Definition deferred until after the definition of Cursor.
   [[nodiscard]] Cursor
   getCursor() const;
@@ -235,12 +531,39 @@ struct Node {
     return {ts_node_start_point(impl), ts_node_end_point(impl)};
   }
 
+  [[nodiscard]] Range
+  getRange() const {
+    return {ts_node_start_point(impl), ts_node_end_point(impl),
+            ts_node_start_byte(impl), ts_node_end_byte(impl)};
+  }
+
   [[nodiscard]] std::string_view
   getSourceRange(std::string_view source) const {
     Extent<uint32_t> extents = this->getByteRange();
     return source.substr(extents.start, extents.end - extents.start);
   }
 
+  // Reads all of the attributes in NodeInfo with one tree-sitter call per
+  // attribute, except isError, so it only saves calls for code that needs
+  // most of the attributes.
+  [[nodiscard]] NodeInfo
+  getInfo() const {
+    Symbol symbol = ts_node_symbol(impl);
+    return {
+      symbol,
+      ts_node_is_named(impl),
+      ts_node_is_missing(impl),
+      ts_node_is_extra(impl),
+      ts_node_has_error(impl),
+      // Equivalent to ts_node_is_error, without calling back into tree-sitter.
+      symbol == static_cast<Symbol>(-1),
+      {ts_node_start_point(impl), ts_node_end_point(impl),
+       ts_node_start_byte(impl), ts_node_end_byte(impl)},
+      ts_node_child_count(impl),
+      ts_node_named_child_count(impl),
+    };
+  }
+
   TSNode impl;
 };
 
@@ -266,30 +589,425 @@ public:
     return getRootNode().hasError();
   }
 
+  // Returns the ERROR and MISSING nodes in the tree, in preorder, stopping
+  // after `limit` of them. Definition deferred until after ErrorRange.
+  [[nodiscard]] ErrorRange
+  errors(size_t limit = SIZE_MAX) const;
+
+  // Returns an independent copy of the tree that shares its immutable
+  // internals, so copying is O(1). tree-sitter trees must not be used from
+  // several threads at once, so each thread should work on its own clone.
+  [[nodiscard]] Tree
+  clone() const {
+    return ts_tree_copy(impl.get());
+  }
+
+  // Returns the ranges of the source that the tree was parsed from.
+  [[nodiscard]] Ranges
+  getIncludedRanges() const {
+    uint32_t count = 0;
+    Range* ranges = ts_tree_included_ranges(impl.get(), &count);
+    return Ranges{ranges, count};
+  }
+
+  ////////////////////////////////////////////////////////////////
+  // Incremental parsing
+  ////////////////////////////////////////////////////////////////
+
+  // Adjusts the positions in the tree to account for an edit to the source.
+  // The edited tree can then be passed to Parser::parseString so that the
+  // unchanged portions of it are reused.
+  void
+  edit(const InputEdit& edit) {
+    TSInputEdit raw{edit.startByte, edit.oldEndByte, edit.newEndByte,
+                    edit.startPoint, edit.oldEndPoint, edit.newEndPoint};
+    ts_tree_edit(impl.get(), &raw);
+  }
+
+  // Returns the ranges whose syntactic structure differs between `oldTree`
+  // and this tree. `oldTree` must be the edited tree that this tree was
+  // reparsed from.
+  [[nodiscard]] Ranges
+  getChangedRanges(const Tree& oldTree) const {
+    uint32_t count = 0;
+    Range* ranges = ts_tree_get_changed_ranges(oldTree.impl.get(),
+                                               impl.get(),
+                                               &count);
+    return Ranges{ranges, count};
+  }
+
 private:
+  friend class Parser;
+
   std::unique_ptr<TSTree, decltype(&ts_tree_delete)> impl;
 };
 
 
+// A copyable handle to an immutable tree that is shared between threads.
+// The shared tree itself is never used directly; instead each thread takes
+// its own cheap clone and reads that. Nodes from a clone are only valid for
+// the lifetime of that clone.
+class SharedTree {
+public:
+  explicit SharedTree(Tree tree)
+    : impl{std::make_shared<const Tree>(std::move(tree))}
+      { }
+
+  // Safe to call from any number of threads at once.
+  [[nodiscard]] Tree
+  clone() const {
+    return impl->clone();
+  }
+
+  [[nodiscard]] Language
+  getLanguage() const {
+    return impl->getLanguage();
+  }
+
+private:
+  std::shared_ptr<const Tree> impl;
+};
+
+
+// Thrown by the parsing methods of Parser when a timeout or cancellation
+// token stops a parse before it completes. The tryParse methods report this
+// by returning nothing instead.
+class ParseStoppedError : public std::runtime_error {
+public:
+  ParseStoppedError()
+    : std::runtime_error{"The parse was stopped before it completed"}
+      { }
+};
+
+
+// Allows a parse to be cancelled from another thread. A single token may be
+// shared by several parsers, and cancelling it stops all of their parses.
+class CancellationToken {
+public:
+  CancellationToken() = default;
+  CancellationToken(const CancellationToken& other) = delete;
+  CancellationToken& operator=(const CancellationToken& other) = delete;
+
+  void
+  cancel() {
+    std::atomic_ref<size_t>{flag}.store(1, std::memory_order_relaxed);
+  }
+
+  // Allows parses to run again, e.g. before resuming a cancelled parse.
+  void
+  reset() {
+    std::atomic_ref<size_t>{flag}.store(0, std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] bool
+  isCancelled() const {
+    return std::atomic_ref<size_t>{flag}.load(std::memory_order_relaxed) != 0;
+  }
+
+private:
+  friend class Parser;
+
+  // tree-sitter polls a plain size_t, so the flag is accessed atomically
+  // through atomic_ref rather than stored as a std::atomic.
+  alignas(std::atomic_ref<size_t>::required_alignment) mutable size_t flag = 0;
+};
+
+
+// A reader provides the source text to a parser in chunks. Given the byte
+// offset and point at which parsing should continue, it returns a chunk of the
+// source starting at that position. An empty chunk marks the end of input.
+// The returned chunk must remain valid until the reader is next invoked.
+template <typename Reader>
+concept InputReader =
+  std::invocable<Reader&, uint32_t, Point>
+  && std::convertible_to<std::invoke_result_t<Reader&, uint32_t, Point>,
+                         std::string_view>;
+
+
+// Measurements of a single parse, reported to a parser's observer.
+struct ParseStats {
+  std::chrono::nanoseconds duration;
+  // The length of the parsed input. For chunked input, this is the end of
+  // the parsed tree instead.
+  size_t numBytes;
+  uint32_t numNodes;
+  // The number of ERROR and MISSING nodes in the tree.
+  uint32_t numErrors;
+  bool wasIncremental;
+  // For incremental parses, the fraction of the input outside of the ranges
+  // that changed relative to the old tree.
+  double reuseRatio;
+  // False if the parse was stopped by a timeout or cancellation.
+  bool completed;
+};
+
+
 class Parser {
 public:
+  using Observer = std::function<void(const ParseStats&)>;
+  using Logger = std::function<void(TSLogType type, std::string_view message)>;
+
   Parser(Language language)
     : impl{ts_parser_new(), ts_parser_delete} {
     ts_parser_set_language(impl.get(), language.impl);
   }
 
+  [[nodiscard]] Language
+  getLanguage() const {
+    return ts_parser_language(impl.get());
+  }
+
+  // Discards any state left over from an incomplete parse so that the next
+  // parse starts from the beginning of its input.
+  void
+  reset() {
+    ts_parser_reset(impl.get());
+  }
+
+  // Restores every option set on the parser to its default: no timeout, no
+  // cancellation token, no included ranges, no logger, and no observer.
+  // Parsers handed between unrelated users, such as pooled ones, should be
+  // restored so that they hold nothing that refers to their previous user.
+  void
+  restoreDefaults() {
+    setTimeout(std::chrono::microseconds{0});
+    setCancellationToken(nullptr);
+    (void)setIncludedRanges({});
+    setLogger({});
+    setObserver({});
+  }
+
+  // The parsing methods throw ParseStoppedError if a timeout or cancellation
+  // token (see below) stops the parse. Use the tryParse methods to handle
+  // stopped parses without exceptions.
+
   [[nodiscard]] Tree
   parseString(std::string_view buffer) {
-    return ts_parser_parse_string(
+    return unwrapResult(parseStringImpl(buffer, nullptr));
+  }
+
+  // Reparses `buffer`, reusing the parts of `oldTree` that were unaffected by
+  // the edits applied to it via Tree::edit.
+  [[nodiscard]] Tree
+  parseString(std::string_view buffer, const Tree& oldTree) {
+    return unwrapResult(parseStringImpl(buffer, oldTree.impl.get()));
+  }
+
+  // Parses a source provided in chunks by `reader`, avoiding the need to copy
+  // non-contiguous storage into a single buffer.
+  template <InputReader Reader>
+  [[nodiscard]] Tree
+  parse(Reader&& reader) {
+    return unwrapResult(parseImpl(reader, nullptr));
+  }
+
+  template <InputReader Reader>
+  [[nodiscard]] Tree
+  parse(Reader&& reader, const Tree& oldTree) {
+    return unwrapResult(parseImpl(reader, oldTree.impl.get()));
+  }
+
+  ////////////////////////////////////////////////////////////////
+  // Instrumentation
+  ////////////////////////////////////////////////////////////////
+
+  // Reports ParseStats for every subsequent parse to `observer`. Gathering
+  // the stats costs a clock read, and for incremental parses a comparison
+  // of the old and new trees, so parses only pay for them while an observer
+  // is set. Passing an empty observer removes it.
+  void
+  setObserver(Observer observer) {
+    this->observer = std::move(observer);
+  }
+
+  // Forwards tree-sitter's debug log for subsequent parses to `logger`.
+  // Passing an empty logger removes it. The logger must not throw.
+  void
+  setLogger(Logger logger) {
+    if (!logger) {
+      ts_parser_set_logger(impl.get(), TSLogger{nullptr, nullptr});
+      this->logger.reset();
+      return;
+    }
+    // The logger is boxed so that its address is stable as the parser moves.
+    this->logger = std::make_unique<Logger>(std::move(logger));
+    auto log = [](void* payload, TSLogType type, const char* message) {
+      (*static_cast<Logger*>(payload))(type, message);
+    };
+    ts_parser_set_logger(impl.get(), TSLogger{this->logger.get(), log});
+  }
+
+  ////////////////////////////////////////////////////////////////
+  // Included ranges
+  ////////////////////////////////////////////////////////////////
+
+  // Restricts subsequent parses to the given ranges of their input, e.g. to
+  // parse a language embedded within another document in place. Positions in
+  // the resulting trees remain relative to the whole input. The ranges must
+  // be sorted and must not overlap; otherwise this returns false and the
+  // parser reverts to parsing whole inputs. An empty span removes the
+  // restriction.
+  [[nodiscard]] bool
+  setIncludedRanges(std::span<const Range> ranges) {
+    return ts_parser_set_included_ranges(impl.get(),
+                                         ranges.data(),
+                                         static_cast<uint32_t>(ranges.size()));
+  }
+
+  [[nodiscard]] std::span<const Range>
+  getIncludedRanges() const {
+    uint32_t count = 0;
+    const Range* ranges = ts_parser_included_ranges(impl.get(), &count);
+    return {ranges, count};
+  }
+
+  ////////////////////////////////////////////////////////////////
+  // Bounded parsing
+  ////////////////////////////////////////////////////////////////
+
+  // A parse stops once it has run for longer than the timeout or once the
+  // cancellation token is cancelled. Calling a parsing method again with the
+  // same input resumes a stopped parse from where it left off, while reset()
+  // abandons it so that a different input can be parsed.
+
+  // A timeout of zero, the default, disables the timeout.
+  void
+  setTimeout(std::chrono::microseconds timeout) {
+    ts_parser_set_timeout_micros(impl.get(),
+                                 static_cast<uint64_t>(timeout.count()));
+  }
+
+  [[nodiscard]] std::chrono::microseconds
+  getTimeout() const {
+    auto micros = ts_parser_timeout_micros(impl.get());
+    return std::chrono::microseconds{static_cast<int64_t>(micros)};
+  }
+
+  // The token must outlive its use by the parser. Passing nullptr removes it.
+  void
+  setCancellationToken(const CancellationToken* token) {
+    ts_parser_set_cancellation_flag(impl.get(), token ? &token->flag : nullptr);
+  }
+
+  // As the parsing methods above, but returns nothing if the parse was
+  // stopped by the timeout or the cancellation token.
+
+  [[nodiscard]] std::optional<Tree>
+  tryParseString(std::string_view buffer) {
+    return wrapResult(parseStringImpl(buffer, nullptr));
+  }
+
+  [[nodiscard]] std::optional<Tree>
+  tryParseString(std::string_view buffer, const Tree& oldTree) {
+    return wrapResult(parseStringImpl(buffer, oldTree.impl.get()));
+  }
+
+  template <InputReader Reader>
+  [[nodiscard]] std::optional<Tree>
+  tryParse(Reader&& reader) {
+    return wrapResult(parseImpl(reader, nullptr));
+  }
+
+  template <InputReader Reader>
+  [[nodiscard]] std::optional<Tree>
+  tryParse(Reader&& reader, const Tree& oldTree) {
+    return wrapResult(parseImpl(reader, oldTree.impl.get()));
+  }
+
+private:
+  static std::optional<Tree>
+  wrapResult(TSTree* tree) {
+    if (!tree) {
+      return std::nullopt;
+    }
+    return Tree{tree};
+  }
+
+  static Tree
+  unwrapResult(TSTree* tree) {
+    if (!tree) {
+      throw ParseStoppedError{};
+    }
+    return Tree{tree};
+  }
+
+  template <typename Reader>
+  [[nodiscard]] TSTree*
+  parseImpl(Reader& reader, TSTree const* oldTree) {
+    auto read = [](void* payload,
+                   uint32_t byte,
+                   TSPoint position,
+                   uint32_t* bytesRead) -> const char* {
+      std::string_view chunk = (*static_cast<Reader*>(payload))(byte, position);
+      *bytesRead = static_cast<uint32_t>(chunk.size());
+      return chunk.data();
+    };
+    void* payload = const_cast<void*>(static_cast<const void*>(&reader));
+    auto start = observer ? std::chrono::steady_clock::now()
+                          : std::chrono::steady_clock::time_point{};
+    TSTree* tree = ts_parser_parse(impl.get(),
+                                   oldTree,
+                                   TSInput{payload, read, TSInputEncodingUTF8});
+    if (observer) {
+      size_t numBytes = tree ? ts_node_end_byte(ts_tree_root_node(tree)) : 0;
+      report(start, oldTree, tree, numBytes);
+    }
+    return tree;
+  }
+
+  [[nodiscard]] TSTree*
+  parseStringImpl(std::string_view buffer, TSTree const* oldTree) {
+    auto start = observer ? std::chrono::steady_clock::now()
+                          : std::chrono::steady_clock::time_point{};
+    TSTree* tree = ts_parser_parse_string(
       impl.get(),
-      nullptr,
-      &buffer.front(),
+      oldTree,
+      buffer.data(),
       static_cast<uint32_t>(buffer.size())
     );
+    if (observer) {
+      report(start, oldTree, tree, buffer.size());
+    }
+    return tree;
   }
 
-private:
+  void
+  report(std::chrono::steady_clock::time_point start,
+         TSTree const* oldTree,
+         TSTree const* tree,
+         size_t numBytes) const {
+    ParseStats stats{};
+    stats.duration = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start);
+    stats.numBytes = numBytes;
+    stats.wasIncremental = oldTree != nullptr;
+    stats.completed = tree != nullptr;
+    if (tree) {
+      Node root{ts_tree_root_node(tree)};
+      stats.numNodes = root.getNumDescendants();
+      stats.numErrors = countErrors(root);
+    }
+    if (tree && oldTree && numBytes > 0) {
+      uint32_t count = 0;
+      Ranges changed{ts_tree_get_changed_ranges(oldTree, tree, &count), count};
+      size_t changedBytes = 0;
+      for (const Range& range : changed) {
+        changedBytes += range.end_byte - range.start_byte;
+      }
+      stats.reuseRatio = 1.0 - static_cast<double>(std::min(changedBytes, numBytes))
+                               / static_cast<double>(numBytes);
+    }
+    observer(stats);
+  }
+
+  // Only subtrees containing errors are searched, so this is cheap for trees
+  // with few errors. Defined after ErrorRange.
+  static uint32_t
+  countErrors(Node root);
+
   std::unique_ptr<TSParser, decltype(&ts_parser_delete)> impl;
+  Observer observer;
+  std::unique_ptr<Logger> logger;
 };
 
 
@@ -338,6 +1056,24 @@ public:
   getCurrentNode() const {
     return Node{ts_tree_cursor_current_node(&impl)};
   }
+
+  [[nodiscard]] NodeInfo
+  getCurrentInfo() const {
+    return getCurrentNode().getInfo();
+  }
+
+  // Returns 0 if the current node is not associated with a field.
+  [[nodiscard]] FieldID
+  getCurrentFieldID() const {
+    return ts_tree_cursor_current_field_id(&impl);
+  }
+
+  // Returns an empty name if the current node is not associated with a field.
+  [[nodiscard]] std::string_view
+  getCurrentFieldName() const {
+    const char* name = ts_tree_cursor_current_field_name(&impl);
+    return name ? name : std::string_view{};
+  }
   
   // Navigation
 
@@ -366,11 +1102,36 @@ public:
     return ts_tree_cursor_goto_last_child(&impl);
   }
 
+  // Moves to the first child that extends beyond the given position.
+
+  [[nodiscard]] bool
+  gotoFirstChildForByte(uint32_t byte) {
+    return ts_tree_cursor_goto_first_child_for_byte(&impl, byte) >= 0;
+  }
+
+  [[nodiscard]] bool
+  gotoFirstChildForPoint(Point point) {
+    return ts_tree_cursor_goto_first_child_for_point(&impl, point) >= 0;
+  }
+
   [[nodiscard]] size_t
   getDepthFromOrigin() const {
     return ts_tree_cursor_current_depth(&impl);
   }
 
+  // Descendants are numbered in preorder from the node that the cursor was
+  // created for, which is descendant 0.
+
+  void
+  gotoDescendant(uint32_t descendantIndex) {
+    ts_tree_cursor_goto_descendant(&impl, descendantIndex);
+  }
+
+  [[nodiscard]] uint32_t
+  getCurrentDescendantIndex() const {
+    return ts_tree_cursor_current_descendant_index(&impl);
+  }
+
 private:
   TSTreeCursor impl;
 };
@@ -383,65 +1144,677 @@ inline Node::getCursor() const {
 }
 
 
+// Finds the smallest node below `root` containing each of `offsets`, which
+// must be sorted. This matches calling getDescendantForByteRange for each
+// offset, but a single cursor walks between consecutive offsets instead of
+// descending from the root each time. Offsets outside of `root` resolve to
+// `root`.
+[[nodiscard]] inline std::vector<Node>
+locateAll(Node root, std::span<const uint32_t> offsets) {
+  std::vector<Node> located;
+  located.reserve(offsets.size());
+  Cursor cursor = root.getCursor();
+  for (uint32_t offset : offsets) {
+    auto contains = [offset](Node node) {
+      Extent<uint32_t> range = node.getByteRange();
+      return range.start <= offset && offset < range.end;
+    };
+    while (!contains(cursor.getCurrentNode()) && cursor.gotoParent()) {
+    }
+    // The child found may end exactly at the offset, so skip ahead to the
+    // first child that actually contains it.
+    while (cursor.gotoFirstChildForByte(offset)) {
+      bool found = false;
+      do {
+        Extent<uint32_t> range = cursor.getCurrentNode().getByteRange();
+        found = range.start <= offset && offset < range.end;
+        if (found || range.start > offset) {
+          break;
+        }
+      } while (cursor.gotoNextSibling());
+      if (!found) {
+        (void)cursor.gotoParent();
+        break;
+      }
+    }
+    located.push_back(cursor.getCurrentNode());
+  }
+  return located;
+}
+
+
 ////////////////////////////////////////////////////////////////
 // Child node iterators
 ////////////////////////////////////////////////////////////////
 
 // These iterators make it possible to use C++ views on Nodes for
-// easy processing.
+// easy processing. Child views are sized and bidirectional, and the named
+// variants skip anonymous children. A view owns a single cursor, created the
+// first time that a child is read, and its iterators are only positions
+// within the view. Copying an iterator is therefore free, which matters for
+// adaptors such as std::views::reverse that copy iterators on every access.
+// Iterating over a leaf creates no cursor at all.
+//
+// Iterators refer to their view, so the view must outlive them, and a view
+// must not be iterated from several threads at once.
 
 class ChildIteratorSentinel { };
 
-class ChildIterator {
+template <bool NAMED_ONLY>
+struct BasicChildren;
+
+
+namespace detail {
+
+// The cursor of a child view, positioned on the child most recently read.
+// Copies of a view start without a cursor rather than copying it.
+template <bool NAMED_ONLY>
+class ChildCursor {
+public:
+  ChildCursor() = default;
+  ChildCursor(const ChildCursor&) { }
+  ChildCursor(ChildCursor&& other) = default;
+
+  ChildCursor&
+  operator=(const ChildCursor&) {
+    cursor.reset();
+    return *this;
+  }
+
+  ChildCursor& operator=(ChildCursor&& other) = default;
+
+  // Returns the child at `target`, stepping the cursor from the child that
+  // it was last on.
+  [[nodiscard]] Node
+  moveTo(const Node& parent, uint32_t target, uint32_t count) {
+    if (!cursor) {
+      cursor.emplace(parent.getCursor());
+      if (target < count / 2) {
+        (void)cursor->gotoFirstChild();
+        skipForward();
+        position = 0;
+      } else {
+        (void)cursor->gotoLastChild();
+        skipBackward();
+        position = count - 1;
+      }
+    }
+    for (; position < target; ++position) {
+      (void)cursor->gotoNextSibling();
+      skipForward();
+    }
+    for (; position > target; --position) {
+      (void)cursor->gotoPreviousSibling();
+      skipBackward();
+    }
+    return cursor->getCurrentNode();
+  }
+
+private:
+  void
+  skipForward() {
+    while (NAMED_ONLY && !cursor->getCurrentNode().isNamed()
+           && cursor->gotoNextSibling()) {
+    }
+  }
+
+  void
+  skipBackward() {
+    while (NAMED_ONLY && !cursor->getCurrentNode().isNamed()
+           && cursor->gotoPreviousSibling()) {
+    }
+  }
+
+  std::optional<ts::Cursor> cursor;
+  uint32_t position = 0;
+};
+
+}
+
+
+template <bool NAMED_ONLY>
+class BasicChildIterator {
+public:
+  using value_type = ts::Node;
+  using difference_type = int;
+  using iterator_category = std::bidirectional_iterator_tag;
+
+  BasicChildIterator() = default;
+
+  BasicChildIterator(const BasicChildren<NAMED_ONLY>& children, uint32_t position)
+    : children{&children},
+      position{position}
+      { }
+
+  value_type
+  operator*() const {
+    return children->getChild(position);
+  }
+
+  BasicChildIterator&
+  operator++() {
+    ++position;
+    return *this;
+  }
+
+  BasicChildIterator
+  operator++(int) {
+    BasicChildIterator old{*this};
+    ++position;
+    return old;
+  }
+
+  BasicChildIterator&
+  operator--() {
+    --position;
+    return *this;
+  }
+
+  BasicChildIterator
+  operator--(int) {
+    BasicChildIterator old{*this};
+    --position;
+    return old;
+  }
+
+  // The index of the current child among the children in the view.
+  [[nodiscard]] uint32_t
+  getPosition() const {
+    return position;
+  }
+
+  // Iterators are only comparable with those of the same view.
+  friend bool operator== (const BasicChildIterator& a, const BasicChildIterator& b) { return a.position == b.position; }
+  friend bool operator== (const BasicChildIterator& a, const ChildIteratorSentinel&)   { return a.position == a.children->size(); }
+  friend bool operator!= (const BasicChildIterator& a, const ChildIteratorSentinel& b) { return !(a == b); }
+  friend bool operator== (const ChildIteratorSentinel& b, const BasicChildIterator& a) { return a == b; }
+  friend bool operator!= (const ChildIteratorSentinel& b, const BasicChildIterator& a) { return a != b; }
+
+private:
+  const BasicChildren<NAMED_ONLY>* children = nullptr;
+  uint32_t position = 0;
+};
+
+
+template <bool NAMED_ONLY>
+struct BasicChildren {
+  using iterator = BasicChildIterator<NAMED_ONLY>;
+  using sentinel = iterator;
+
+  auto begin() const -> iterator { return iterator{*this, 0}; }
+  auto end() const -> sentinel {
+    return iterator{*this, static_cast<uint32_t>(size())};
+  }
+
+  [[nodiscard]] size_t
+  size() const {
+    return NAMED_ONLY ? node.getNumNamedChildren() : node.getNumChildren();
+  }
+
+  [[nodiscard]] bool
+  empty() const {
+    return size() == 0;
+  }
+
+  // Indexed access does not create a cursor, but tree-sitter finds the child
+  // by scanning from the first, so iterate when visiting every child.
+  [[nodiscard]] Node
+  operator[](uint32_t position) const {
+    return NAMED_ONLY ? node.getNamedChild(position) : node.getChild(position);
+  }
+
+  // Reads a child through the view's cursor. Consecutive positions cost a
+  // single step of the cursor.
+  [[nodiscard]] Node
+  getChild(uint32_t position) const {
+    return cursor.moveTo(node, position, static_cast<uint32_t>(size()));
+  }
+
+  ts::Node node;
+  mutable detail::ChildCursor<NAMED_ONLY> cursor = {};
+};
+
+
+using ChildIterator = BasicChildIterator<false>;
+using NamedChildIterator = BasicChildIterator<true>;
+
+using Children = BasicChildren<false>;
+using NamedChildren = BasicChildren<true>;
+
+static_assert(std::input_iterator<ChildIterator>);
+static_assert(std::sentinel_for<ChildIteratorSentinel, ChildIterator>);
+static_assert(std::bidirectional_iterator<ChildIterator>);
+static_assert(std::bidirectional_iterator<NamedChildIterator>);
+static_assert(std::ranges::bidirectional_range<Children>);
+static_assert(std::ranges::sized_range<Children>);
+static_assert(std::ranges::common_range<NamedChildren>);
+
+
+////////////////////////////////////////////////////////////////
+// Subtree traversals
+////////////////////////////////////////////////////////////////
+
+// Preorder and postorder traversals of the subtree rooted at a node. Each
+// traversal moves a single cursor through the subtree, so walking an entire
+// tree costs one cursor rather than one per internal node. The named variants
+// only yield named nodes but still descend through anonymous ones.
+
+class TraversalSentinel { };
+
+template <bool NAMED_ONLY>
+class BasicPreorderIterator {
 public:
   using value_type = ts::Node;
   using difference_type = int;
   using iterator_category = std::input_iterator_tag;
 
-  explicit ChildIterator(const ts::Node& node)
+  explicit BasicPreorderIterator(const ts::Node& node)
     : cursor{node.getCursor()},
-      atEnd{!cursor.gotoFirstChild()}
-      { }
+      atEnd{false} {
+    if (NAMED_ONLY && !node.isNamed()) {
+      advance();
+    }
+  }
+
+  value_type
+  operator*() const {
+    return cursor.getCurrentNode();
+  }
+
+  BasicPreorderIterator&
+  operator++() {
+    advance();
+    return *this;
+  }
+
+  BasicPreorderIterator&
+  operator++(int) {
+    advance();
+    return *this;
+  }
+
+  // The depth of the current node below the root of the traversal.
+  [[nodiscard]] size_t
+  getDepth() const {
+    return cursor.getDepthFromOrigin();
+  }
+
+  friend bool operator== (const BasicPreorderIterator& a, const TraversalSentinel&)   { return a.atEnd; }
+  friend bool operator!= (const BasicPreorderIterator& a, const TraversalSentinel& b) { return !(a == b); }
+  friend bool operator== (const TraversalSentinel& b, const BasicPreorderIterator& a) { return a == b; }
+  friend bool operator!= (const TraversalSentinel& b, const BasicPreorderIterator& a) { return a != b; }
+
+private:
+  void
+  advance() {
+    do {
+      atEnd = !step();
+    } while (NAMED_ONLY && !atEnd && !cursor.getCurrentNode().isNamed());
+  }
+
+  // The cursor cannot leave the subtree that it was created for, so failing
+  // to find a parent means that the traversal has returned to its root.
+  bool
+  step() {
+    if (cursor.gotoFirstChild()) {
+      return true;
+    }
+    do {
+      if (cursor.gotoNextSibling()) {
+        return true;
+      }
+    } while (cursor.gotoParent());
+    return false;
+  }
+
+  ts::Cursor cursor;
+  bool atEnd;
+};
+
+
+template <bool NAMED_ONLY>
+class BasicPostorderIterator {
+public:
+  using value_type = ts::Node;
+  using difference_type = int;
+  using iterator_category = std::input_iterator_tag;
+
+  explicit BasicPostorderIterator(const ts::Node& node)
+    : cursor{node.getCursor()},
+      atEnd{false} {
+    descendToLeaf();
+    if (NAMED_ONLY && !cursor.getCurrentNode().isNamed()) {
+      advance();
+    }
+  }
 
   value_type
   operator*() const {
     return cursor.getCurrentNode();
   }
 
-  ChildIterator&
+  BasicPostorderIterator&
   operator++() {
-    atEnd = !cursor.gotoNextSibling();
+    advance();
     return *this;
   }
 
-  ChildIterator&
+  BasicPostorderIterator&
   operator++(int) {
-    atEnd = !cursor.gotoNextSibling();
+    advance();
     return *this;
   }
 
-  friend bool operator== (const ChildIterator& a, const ChildIteratorSentinel&)   { return a.atEnd; }
-  friend bool operator!= (const ChildIterator& a, const ChildIteratorSentinel& b) { return !(a == b); }
-  friend bool operator== (const ChildIteratorSentinel& b, const ChildIterator& a) { return a == b; }
-  friend bool operator!= (const ChildIteratorSentinel& b, const ChildIterator& a) { return a != b; }
+  // The depth of the current node below the root of the traversal.
+  [[nodiscard]] size_t
+  getDepth() const {
+    return cursor.getDepthFromOrigin();
+  }
+
+  friend bool operator== (const BasicPostorderIterator& a, const TraversalSentinel&)   { return a.atEnd; }
+  friend bool operator!= (const BasicPostorderIterator& a, const TraversalSentinel& b) { return !(a == b); }
+  friend bool operator== (const TraversalSentinel& b, const BasicPostorderIterator& a) { return a == b; }
+  friend bool operator!= (const TraversalSentinel& b, const BasicPostorderIterator& a) { return a != b; }
 
 private:
+  void
+  advance() {
+    do {
+      atEnd = !step();
+    } while (NAMED_ONLY && !atEnd && !cursor.getCurrentNode().isNamed());
+  }
+
+  bool
+  step() {
+    if (cursor.gotoNextSibling()) {
+      descendToLeaf();
+      return true;
+    }
+    return cursor.gotoParent();
+  }
+
+  void
+  descendToLeaf() {
+    while (cursor.gotoFirstChild()) { }
+  }
+
   ts::Cursor cursor;
   bool atEnd;
 };
 
 
-struct Children {
-  using iterator = ChildIterator;
-  using sentinel = ChildIteratorSentinel;
+template <bool NAMED_ONLY>
+struct BasicPreorderRange {
+  using iterator = BasicPreorderIterator<NAMED_ONLY>;
+  using sentinel = TraversalSentinel;
 
-  auto begin() const -> iterator { return ChildIterator{node}; }
+  auto begin() const -> iterator { return iterator{node}; }
   auto end() const -> sentinel { return {}; }
-  const ts::Node& node;
+  ts::Node node;
 };
 
-static_assert(std::input_iterator<ChildIterator>);
-static_assert(std::sentinel_for<ChildIteratorSentinel, ChildIterator>);
+
+template <bool NAMED_ONLY>
+struct BasicPostorderRange {
+  using iterator = BasicPostorderIterator<NAMED_ONLY>;
+  using sentinel = TraversalSentinel;
+
+  auto begin() const -> iterator { return iterator{node}; }
+  auto end() const -> sentinel { return {}; }
+  ts::Node node;
+};
+
+
+using PreorderIterator = BasicPreorderIterator<false>;
+using NamedPreorderIterator = BasicPreorderIterator<true>;
+using PostorderIterator = BasicPostorderIterator<false>;
+using NamedPostorderIterator = BasicPostorderIterator<true>;
+
+using PreorderRange = BasicPreorderRange<false>;
+using NamedPreorderRange = BasicPreorderRange<true>;
+using PostorderRange = BasicPostorderRange<false>;
+using NamedPostorderRange = BasicPostorderRange<true>;
+
+static_assert(std::input_iterator<PreorderIterator>);
+static_assert(std::sentinel_for<TraversalSentinel, PreorderIterator>);
+static_assert(std::input_iterator<PostorderIterator>);
+static_assert(std::sentinel_for<TraversalSentinel, PostorderIterator>);
+static_assert(std::ranges::input_range<PreorderRange>);
+static_assert(std::ranges::input_range<NamedPostorderRange>);
+
+
+////////////////////////////////////////////////////////////////
+// Error search
+////////////////////////////////////////////////////////////////
+
+// Finds the ERROR and MISSING nodes below a node. Only subtrees that contain
+// errors are entered, so locating a few errors in a large tree visits the
+// paths to those errors rather than the whole tree.
+
+class ErrorIterator {
+public:
+  using value_type = ts::Node;
+  using difference_type = int;
+  using iterator_category = std::input_iterator_tag;
+
+  ErrorIterator(const ts::Node& node, size_t limit)
+    : cursor{node.getCursor()},
+      remaining{limit},
+      atEnd{limit == 0 || !node.hasError()} {
+    if (!atEnd && !isErrorNode(node)) {
+      advance();
+    }
+  }
+
+  value_type
+  operator*() const {
+    return cursor.getCurrentNode();
+  }
+
+  ErrorIterator&
+  operator++() {
+    --remaining;
+    if (remaining == 0) {
+      atEnd = true;
+    } else {
+      advance();
+    }
+    return *this;
+  }
+
+  ErrorIterator&
+  operator++(int) {
+    return ++*this;
+  }
+
+  friend bool operator== (const ErrorIterator& a, const TraversalSentinel&)   { return a.atEnd; }
+  friend bool operator!= (const ErrorIterator& a, const TraversalSentinel& b) { return !(a == b); }
+  friend bool operator== (const TraversalSentinel& b, const ErrorIterator& a) { return a == b; }
+  friend bool operator!= (const TraversalSentinel& b, const ErrorIterator& a) { return a != b; }
+
+private:
+  static bool
+  isErrorNode(Node node) {
+    return node.isError() || node.isMissing();
+  }
+
+  void
+  advance() {
+    do {
+      atEnd = !step();
+    } while (!atEnd && !isErrorNode(cursor.getCurrentNode()));
+  }
+
+  // Like a preorder step, but subtrees without errors are skipped.
+  bool
+  step() {
+    if (cursor.getCurrentNode().hasError() && cursor.gotoFirstChild()) {
+      return true;
+    }
+    do {
+      if (cursor.gotoNextSibling()) {
+        return true;
+      }
+    } while (cursor.gotoParent());
+    return false;
+  }
+
+  ts::Cursor cursor;
+  size_t remaining;
+  bool atEnd;
+};
+
+
+struct ErrorRange {
+  using iterator = ErrorIterator;
+  using sentinel = TraversalSentinel;
+
+  auto begin() const -> iterator { return iterator{node, limit}; }
+  auto end() const -> sentinel { return {}; }
+  ts::Node node;
+  size_t limit = SIZE_MAX;
+};
+
+static_assert(std::input_iterator<ErrorIterator>);
+static_assert(std::sentinel_for<TraversalSentinel, ErrorIterator>);
+static_assert(std::ranges::input_range<ErrorRange>);
+
+[[nodiscard]] inline ErrorRange
+Tree::errors(size_t limit) const {
+  return ErrorRange{getRootNode(), limit};
+}
+
+inline uint32_t
+Parser::countErrors(Node root) {
+  uint32_t count = 0;
+  for ([[maybe_unused]] Node error : ErrorRange{root}) {
+    ++count;
+  }
+  return count;
+}
+
+
+////////////////////////////////////////////////////////////////
+// Visitors
+////////////////////////////////////////////////////////////////
+
+enum class VisitAction {
+  CONTINUE,
+  SKIP_SUBTREE,
+};
+
+
+// Dispatches handlers while walking a subtree with a single cursor. Handlers
+// are registered per symbol and stored in a table indexed by symbol, so
+// dispatching a node costs an index rather than comparisons of its type.
+// An enter handler may return VisitAction::SKIP_SUBTREE to avoid descending
+// into the children of a node. Leave handlers run for every entered node,
+// including those whose subtrees were skipped.
+//
+// Nodes whose symbols lie outside of the language's symbol table, such as
+// ERROR nodes, are only passed to the fallback handlers.
+class Visitor {
+public:
+  using EnterHandler = std::function<VisitAction(Node)>;
+  using LeaveHandler = std::function<void(Node)>;
+
+  explicit Visitor(Language language)
+    : language{language},
+      enterHandlers(language.getNumSymbols()),
+      leaveHandlers(language.getNumSymbols())
+      { }
+
+  void
+  onEnter(Symbol symbol, EnterHandler handler) {
+    enterHandlers.at(symbol) = std::move(handler);
+  }
+
+  // Resolves `name` to a symbol once, at registration. Throws
+  // std::invalid_argument if the language has no such symbol, or if `name`
+  // is "ERROR", which only the fallbacks receive.
+  void
+  onEnter(std::string_view name, bool isNamed, EnterHandler handler) {
+    onEnter(lookupSymbol(name, isNamed), std::move(handler));
+  }
+
+  void
+  onLeave(Symbol symbol, LeaveHandler handler) {
+    leaveHandlers.at(symbol) = std::move(handler);
+  }
+
+  void
+  onLeave(std::string_view name, bool isNamed, LeaveHandler handler) {
+    onLeave(lookupSymbol(name, isNamed), std::move(handler));
+  }
+
+  // Fallbacks run for nodes that have no handler of their own.
+
+  void
+  onEnterOther(EnterHandler handler) {
+    enterFallback = std::move(handler);
+  }
+
+  void
+  onLeaveOther(LeaveHandler handler) {
+    leaveFallback = std::move(handler);
+  }
+
+  void
+  visit(Node root) const {
+    Cursor cursor = root.getCursor();
+    while (true) {
+      Node node = cursor.getCurrentNode();
+      if (enter(node) == VisitAction::CONTINUE && cursor.gotoFirstChild()) {
+        continue;
+      }
+      leave(node);
+      while (!cursor.gotoNextSibling()) {
+        if (!cursor.gotoParent()) {
+          return;
+        }
+        leave(cursor.getCurrentNode());
+      }
+    }
+  }
+
+private:
+  // tree-sitter returns symbol 0, the end of input, for unknown names, and
+  // its builtin error symbol for "ERROR" and prefixes of it. Neither can
+  // have a handler, as ERROR nodes only reach the fallbacks.
+  [[nodiscard]] Symbol
+  lookupSymbol(std::string_view name, bool isNamed) const {
+    Symbol symbol = name.empty() ? 0 : language.getSymbolForName(name, isNamed);
+    if (symbol == 0 || symbol >= language.getNumSymbols()) {
+      throw std::invalid_argument{"No symbol named " + std::string{name}};
+    }
+    return symbol;
+  }
+
+  VisitAction
+  enter(Node node) const {
+    Symbol symbol = node.getSymbol();
+    if (symbol < enterHandlers.size() && enterHandlers[symbol]) {
+      return enterHandlers[symbol](node);
+    }
+    return enterFallback ? enterFallback(node) : VisitAction::CONTINUE;
+  }
+
+  void
+  leave(Node node) const {
+    Symbol symbol = node.getSymbol();
+    if (symbol < leaveHandlers.size() && leaveHandlers[symbol]) {
+      leaveHandlers[symbol](node);
+    } else if (leaveFallback) {
+      leaveFallback(node);
+    }
+  }
+
+  Language language;
+  std::vector<EnterHandler> enterHandlers;
+  std::vector<LeaveHandler> leaveHandlers;
+  EnterHandler enterFallback;
+  LeaveHandler leaveFallback;
+};
 
 
 }
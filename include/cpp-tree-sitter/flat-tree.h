@@ -0,0 +1,519 @@
+#ifndef CPP_TREE_SITTER_FLAT_TREE_H
+#define CPP_TREE_SITTER_FLAT_TREE_H
+
+#include <bit>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+  #include <immintrin.h>
+#elif defined(__ARM_NEON)
+  #include <arm_neon.h>
+#endif
+
+#include <cpp-tree-sitter.h>
+
+namespace ts {
+
+
+namespace detail {
+
+// Beyond this many symbols, comparing every lane against each symbol costs
+// more than testing each symbol against a bitmap of the set.
+inline constexpr size_t MAX_VECTOR_SCAN_SYMBOLS = 8;
+
+// Calls `emit(index)`, in increasing order, for each index of `symbols` whose
+// symbol is in `wanted`.
+template <typename Emit>
+void
+scanSymbols(std::span<const Symbol> symbols,
+            std::span<const Symbol> wanted,
+            Emit&& emit) {
+  const Symbol* data = symbols.data();
+  const size_t count = symbols.size();
+  size_t index = 0;
+
+  if (wanted.size() > MAX_VECTOR_SCAN_SYMBOLS) {
+    std::vector<uint64_t> bitmap((size_t{1} << 16) / 64, 0);
+    for (Symbol symbol : wanted) {
+      bitmap[symbol / 64] |= uint64_t{1} << (symbol % 64);
+    }
+    for (; index < count; ++index) {
+      if (bitmap[data[index] / 64] & (uint64_t{1} << (data[index] % 64))) {
+        emit(index);
+      }
+    }
+    return;
+  }
+
+  // Each vector comparison yields a byte mask with two bits per 16 bit lane,
+  // so matching lanes are found from the even bits of the mask.
+#if defined(__AVX2__)
+  __m256i broadcast[MAX_VECTOR_SCAN_SYMBOLS];
+  for (size_t i = 0; i < wanted.size(); ++i) {
+    broadcast[i] = _mm256_set1_epi16(static_cast<short>(wanted[i]));
+  }
+  for (; index + 16 <= count; index += 16) {
+    __m256i lanes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + index));
+    __m256i matches = _mm256_setzero_si256();
+    for (size_t i = 0; i < wanted.size(); ++i) {
+      matches = _mm256_or_si256(matches, _mm256_cmpeq_epi16(lanes, broadcast[i]));
+    }
+    auto bits = static_cast<uint32_t>(_mm256_movemask_epi8(matches)) & 0x55555555u;
+    for (; bits; bits &= bits - 1) {
+      emit(index + static_cast<size_t>(std::countr_zero(bits)) / 2);
+    }
+  }
+#elif defined(__SSE2__) || defined(_M_X64)
+  __m128i broadcast[MAX_VECTOR_SCAN_SYMBOLS];
+  for (size_t i = 0; i < wanted.size(); ++i) {
+    broadcast[i] = _mm_set1_epi16(static_cast<short>(wanted[i]));
+  }
+  for (; index + 8 <= count; index += 8) {
+    __m128i lanes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + index));
+    __m128i matches = _mm_setzero_si128();
+    for (size_t i = 0; i < wanted.size(); ++i) {
+      matches = _mm_or_si128(matches, _mm_cmpeq_epi16(lanes, broadcast[i]));
+    }
+    auto bits = static_cast<uint32_t>(_mm_movemask_epi8(matches)) & 0x5555u;
+    for (; bits; bits &= bits - 1) {
+      emit(index + static_cast<size_t>(std::countr_zero(bits)) / 2);
+    }
+  }
+#elif defined(__ARM_NEON)
+  // NEON has no movemask, so matching lanes are narrowed to one byte each
+  // and found from the set bytes of the resulting 64 bit value.
+  uint16x8_t broadcast[MAX_VECTOR_SCAN_SYMBOLS];
+  for (size_t i = 0; i < wanted.size(); ++i) {
+    broadcast[i] = vdupq_n_u16(wanted[i]);
+  }
+  for (; index + 8 <= count; index += 8) {
+    uint16x8_t lanes = vld1q_u16(data + index);
+    uint16x8_t matches = vdupq_n_u16(0);
+    for (size_t i = 0; i < wanted.size(); ++i) {
+      matches = vorrq_u16(matches, vceqq_u16(lanes, broadcast[i]));
+    }
+    uint64_t bits = vget_lane_u64(vreinterpret_u64_u8(vmovn_u16(matches)), 0)
+                    & 0x0101010101010101ull;
+    for (; bits; bits &= bits - 1) {
+      emit(index + static_cast<size_t>(std::countr_zero(bits)) / 8);
+    }
+  }
+#endif
+
+  for (; index < count; ++index) {
+    for (Symbol symbol : wanted) {
+      if (data[index] == symbol) {
+        emit(index);
+        break;
+      }
+    }
+  }
+}
+
+}
+
+
+class FlatTree;
+
+
+// A node within a FlatTree. FlatNodes are lightweight handles pairing a tree
+// with an index and mirror the read only parts of the Node API.
+class FlatNode {
+public:
+  using Index = uint32_t;
+
+  FlatNode(const FlatTree& tree, Index index)
+    : tree{&tree},
+      index{index}
+      { }
+
+  // Flag checks
+
+  [[nodiscard]] bool isNull() const;
+  [[nodiscard]] bool isNamed() const;
+  [[nodiscard]] bool isMissing() const;
+  [[nodiscard]] bool isExtra() const;
+  [[nodiscard]] bool hasError() const;
+  [[nodiscard]] bool isError() const;
+
+  // Navigation
+
+  [[nodiscard]] FlatNode getParent() const;
+  [[nodiscard]] FlatNode getFirstChild() const;
+  [[nodiscard]] FlatNode getNextSibling() const;
+  [[nodiscard]] uint32_t getNumChildren() const;
+  [[nodiscard]] FlatNode getChild(uint32_t position) const;
+  [[nodiscard]] FlatNode getChildByFieldID(FieldID id) const;
+
+  // Attributes
+
+  [[nodiscard]] Index
+  getIndex() const {
+    return index;
+  }
+
+  [[nodiscard]] Symbol getSymbol() const;
+  [[nodiscard]] std::string_view getType() const;
+  [[nodiscard]] FieldID getFieldID() const;
+  [[nodiscard]] Extent<uint32_t> getByteRange() const;
+  [[nodiscard]] std::string_view getSourceRange(std::string_view source) const;
+
+  // The descendants of a node occupy the indices (getIndex(), getSubtreeEnd())
+  // of its tree, as nodes are stored in preorder.
+  [[nodiscard]] Index getSubtreeEnd() const;
+
+  friend bool
+  operator==(const FlatNode& a, const FlatNode& b) {
+    return a.tree == b.tree && a.index == b.index;
+  }
+
+private:
+  const FlatTree* tree;
+  Index index;
+};
+
+
+// An immutable snapshot of a parse tree with its nodes stored in preorder as a
+// structure of arrays. Navigation follows indices within contiguous arrays
+// rather than tree-sitter's subtree pointers, so repeated passes over the
+// snapshot are cache friendly, and because every subtree is a contiguous
+// range of indices, passes can be split across threads by index range.
+//
+// The snapshot does not refer to the tree that it was built from, which may
+// be destroyed or edited afterward. Snapshots share their immutable storage,
+// so copies are cheap and may be read from many threads at once.
+class FlatTree {
+public:
+  using Index = FlatNode::Index;
+
+  static constexpr Index NONE = std::numeric_limits<Index>::max();
+
+  enum Flags : uint8_t {
+    NAMED     = 1u << 0,
+    MISSING   = 1u << 1,
+    EXTRA     = 1u << 2,
+    ERROR     = 1u << 3,
+    HAS_ERROR = 1u << 4,
+  };
+
+  // Views of the columns of a snapshot, each indexed by node.
+  struct Columns {
+    std::span<const Symbol> symbols;
+    std::span<const FieldID> fieldIDs;
+    std::span<const uint8_t> flags;
+    std::span<const uint32_t> startBytes;
+    std::span<const uint32_t> endBytes;
+    std::span<const Index> parents;
+    std::span<const Index> firstChildren;
+    std::span<const Index> nextSiblings;
+    std::span<const Index> subtreeEnds;
+  };
+
+  // Creates a snapshot over columns stored elsewhere, such as within a memory
+  // mapped file. `storage` keeps the columns alive for the snapshot's
+  // lifetime. All columns must have the same length.
+  FlatTree(Language language,
+           const Columns& columns,
+           std::shared_ptr<const void> storage)
+    : language{language},
+      storage{std::move(storage)},
+      symbols{columns.symbols},
+      fieldIDs{columns.fieldIDs},
+      flags{columns.flags},
+      startBytes{columns.startBytes},
+      endBytes{columns.endBytes},
+      parents{columns.parents},
+      firstChildren{columns.firstChildren},
+      nextSiblings{columns.nextSiblings},
+      subtreeEnds{columns.subtreeEnds}
+      { }
+
+  [[nodiscard]] static FlatTree
+  build(const Tree& tree) {
+    return build(tree.getRootNode());
+  }
+
+  // Builds a snapshot of the subtree rooted at `root`.
+  [[nodiscard]] static FlatTree
+  build(Node root) {
+    auto built = std::make_shared<OwnedColumns>();
+    built->reserve(root.getNumDescendants());
+
+    // `ancestors` holds the path from the root to the current node.
+    Cursor cursor = root.getCursor();
+    std::vector<Index> ancestors{built->append(cursor, NONE)};
+    while (true) {
+      if (cursor.gotoFirstChild()) {
+        Index parent = ancestors.back();
+        Index child = built->append(cursor, parent);
+        built->firstChildren[parent] = child;
+        ancestors.push_back(child);
+        continue;
+      }
+
+      while (true) {
+        Index current = ancestors.back();
+        built->subtreeEnds[current] = static_cast<Index>(built->symbols.size());
+        ancestors.pop_back();
+        if (ancestors.empty()) {
+          Columns columns = built->getColumns();
+          return FlatTree{root.getLanguage(), columns, std::move(built)};
+        }
+        if (cursor.gotoNextSibling()) {
+          Index sibling = built->append(cursor, ancestors.back());
+          built->nextSiblings[current] = sibling;
+          ancestors.push_back(sibling);
+          break;
+        }
+        // The cursor is confined to the subtree, so this always succeeds
+        // while there are ancestors left to finish.
+        [[maybe_unused]] bool moved = cursor.gotoParent();
+      }
+    }
+  }
+
+  [[nodiscard]] size_t
+  size() const {
+    return symbols.size();
+  }
+
+  [[nodiscard]] FlatNode
+  getRootNode() const {
+    return FlatNode{*this, symbols.empty() ? NONE : 0};
+  }
+
+  [[nodiscard]] FlatNode
+  getNode(Index index) const {
+    return FlatNode{*this, index};
+  }
+
+  [[nodiscard]] Language
+  getLanguage() const {
+    return language;
+  }
+
+  // Symbol scans. These read only the symbol column, which packs 16 bit
+  // symbols contiguously, and use vector comparisons where available.
+
+  // Returns the indices, in preorder, of all nodes whose symbol is in
+  // `wanted`.
+  [[nodiscard]] std::vector<Index>
+  findAll(std::span<const Symbol> wanted) const {
+    std::vector<Index> found;
+    detail::scanSymbols(symbols, wanted, [&found](size_t index) {
+      found.push_back(static_cast<Index>(index));
+    });
+    return found;
+  }
+
+  [[nodiscard]] std::vector<Index>
+  findAll(Symbol wanted) const {
+    return findAll(std::span{&wanted, 1});
+  }
+
+  // Counts the nodes whose symbol is in `wanted`.
+  [[nodiscard]] size_t
+  count(std::span<const Symbol> wanted) const {
+    size_t total = 0;
+    detail::scanSymbols(symbols, wanted, [&total](size_t) { ++total; });
+    return total;
+  }
+
+  // Returns the number of nodes with each symbol, indexed by symbol. Symbols
+  // outside of the language's symbol table, such as that of ERROR nodes, are
+  // not counted.
+  [[nodiscard]] std::vector<uint32_t>
+  countBySymbol() const {
+    std::vector<uint32_t> counts(language.getNumSymbols(), 0);
+    for (Symbol symbol : symbols) {
+      if (symbol < counts.size()) {
+        ++counts[symbol];
+      }
+    }
+    return counts;
+  }
+
+  [[nodiscard]] Columns
+  getColumns() const {
+    return {symbols, fieldIDs, flags, startBytes, endBytes,
+            parents, firstChildren, nextSiblings, subtreeEnds};
+  }
+
+  // Direct access to the columns of the snapshot, indexed by node.
+
+  [[nodiscard]] std::span<const Symbol> getSymbols() const { return symbols; }
+  [[nodiscard]] std::span<const FieldID> getFieldIDs() const { return fieldIDs; }
+  [[nodiscard]] std::span<const uint8_t> getFlags() const { return flags; }
+  [[nodiscard]] std::span<const uint32_t> getStartBytes() const { return startBytes; }
+  [[nodiscard]] std::span<const uint32_t> getEndBytes() const { return endBytes; }
+  [[nodiscard]] std::span<const Index> getParents() const { return parents; }
+  [[nodiscard]] std::span<const Index> getFirstChildren() const { return firstChildren; }
+  [[nodiscard]] std::span<const Index> getNextSiblings() const { return nextSiblings; }
+  [[nodiscard]] std::span<const Index> getSubtreeEnds() const { return subtreeEnds; }
+
+private:
+  friend class FlatNode;
+
+  // The storage for snapshots built from trees.
+  struct OwnedColumns {
+    void
+    reserve(size_t count) {
+      symbols.reserve(count);
+      fieldIDs.reserve(count);
+      flags.reserve(count);
+      startBytes.reserve(count);
+      endBytes.reserve(count);
+      parents.reserve(count);
+      firstChildren.reserve(count);
+      nextSiblings.reserve(count);
+      subtreeEnds.reserve(count);
+    }
+
+    Index
+    append(const Cursor& cursor, Index parent) {
+      Node node = cursor.getCurrentNode();
+      auto index = static_cast<Index>(symbols.size());
+      Extent<uint32_t> bytes = node.getByteRange();
+      symbols.push_back(node.getSymbol());
+      fieldIDs.push_back(cursor.getCurrentFieldID());
+      flags.push_back(static_cast<uint8_t>(
+          (node.isNamed() ? NAMED : 0)
+        | (node.isMissing() ? MISSING : 0)
+        | (node.isExtra() ? EXTRA : 0)
+        | (node.isError() ? ERROR : 0)
+        | (node.hasError() ? HAS_ERROR : 0)));
+      startBytes.push_back(bytes.start);
+      endBytes.push_back(bytes.end);
+      parents.push_back(parent);
+      firstChildren.push_back(NONE);
+      nextSiblings.push_back(NONE);
+      subtreeEnds.push_back(NONE);
+      return index;
+    }
+
+    [[nodiscard]] Columns
+    getColumns() const {
+      return {symbols, fieldIDs, flags, startBytes, endBytes,
+              parents, firstChildren, nextSiblings, subtreeEnds};
+    }
+
+    std::vector<Symbol> symbols;
+    std::vector<FieldID> fieldIDs;
+    std::vector<uint8_t> flags;
+    std::vector<uint32_t> startBytes;
+    std::vector<uint32_t> endBytes;
+    std::vector<Index> parents;
+    std::vector<Index> firstChildren;
+    std::vector<Index> nextSiblings;
+    std::vector<Index> subtreeEnds;
+  };
+
+  Language language;
+  std::shared_ptr<const void> storage;
+  std::span<const Symbol> symbols;
+  std::span<const FieldID> fieldIDs;
+  std::span<const uint8_t> flags;
+  std::span<const uint32_t> startBytes;
+  std::span<const uint32_t> endBytes;
+  std::span<const Index> parents;
+  std::span<const Index> firstChildren;
+  std::span<const Index> nextSiblings;
+  std::span<const Index> subtreeEnds;
+};
+
+
+// FlatNode methods are defined after FlatTree so that they can use its
+// columns directly.
+
+inline bool FlatNode::isNull() const { return index == FlatTree::NONE; }
+inline bool FlatNode::isNamed() const { return tree->flags[index] & FlatTree::NAMED; }
+inline bool FlatNode::isMissing() const { return tree->flags[index] & FlatTree::MISSING; }
+inline bool FlatNode::isExtra() const { return tree->flags[index] & FlatTree::EXTRA; }
+inline bool FlatNode::hasError() const { return tree->flags[index] & FlatTree::HAS_ERROR; }
+inline bool FlatNode::isError() const { return tree->flags[index] & FlatTree::ERROR; }
+
+inline FlatNode
+FlatNode::getParent() const {
+  return FlatNode{*tree, tree->parents[index]};
+}
+
+inline FlatNode
+FlatNode::getFirstChild() const {
+  return FlatNode{*tree, tree->firstChildren[index]};
+}
+
+inline FlatNode
+FlatNode::getNextSibling() const {
+  return FlatNode{*tree, tree->nextSiblings[index]};
+}
+
+inline uint32_t
+FlatNode::getNumChildren() const {
+  uint32_t count = 0;
+  for (Index child = tree->firstChildren[index];
+       child != FlatTree::NONE;
+       child = tree->nextSiblings[child]) {
+    ++count;
+  }
+  return count;
+}
+
+inline FlatNode
+FlatNode::getChild(uint32_t position) const {
+  Index child = tree->firstChildren[index];
+  for (; child != FlatTree::NONE && position > 0; --position) {
+    child = tree->nextSiblings[child];
+  }
+  return FlatNode{*tree, child};
+}
+
+inline FlatNode
+FlatNode::getChildByFieldID(FieldID id) const {
+  Index child = tree->firstChildren[index];
+  while (child != FlatTree::NONE && tree->fieldIDs[child] != id) {
+    child = tree->nextSiblings[child];
+  }
+  return FlatNode{*tree, child};
+}
+
+inline Symbol
+FlatNode::getSymbol() const {
+  return tree->symbols[index];
+}
+
+inline std::string_view
+FlatNode::getType() const {
+  return tree->language.getSymbolName(getSymbol());
+}
+
+inline FieldID
+FlatNode::getFieldID() const {
+  return tree->fieldIDs[index];
+}
+
+inline Extent<uint32_t>
+FlatNode::getByteRange() const {
+  return {tree->startBytes[index], tree->endBytes[index]};
+}
+
+inline std::string_view
+FlatNode::getSourceRange(std::string_view source) const {
+  Extent<uint32_t> extents = getByteRange();
+  return source.substr(extents.start, extents.end - extents.start);
+}
+
+inline FlatNode::Index
+FlatNode::getSubtreeEnd() const {
+  return tree->subtreeEnds[index];
+}
+
+
+}
+
+#endif
@@ -0,0 +1,336 @@
+#ifndef CPP_TREE_SITTER_INCREMENTAL_QUERY_H
+#define CPP_TREE_SITTER_INCREMENTAL_QUERY_H
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <cpp-tree-sitter.h>
+#include <cpp-tree-sitter/query.h>
+
+namespace ts {
+
+
+// Query results are cached as plain positions rather than Nodes, so that they
+// outlive the tree that they were found in.
+
+struct CachedCapture {
+  Range range;
+  uint32_t index;
+};
+
+struct CachedMatch {
+  uint32_t patternIndex;
+  // The bytes from the start of the first capture to the end of the last.
+  Extent<uint32_t> extent;
+  uint32_t firstCapture;
+  uint32_t numCaptures;
+};
+
+
+// Keeps the matches of a query over a tree current as the tree is edited and
+// reparsed. After each reparse, the query only runs over the regions of the
+// tree that changed, and the matches there replace the cached ones.
+//
+// A changed region is widened to the whole children of the root that it
+// touches, so matches within a top level node such as a function are always
+// recomputed together. Matches are attributed to regions by their extent, so
+// a match of a pattern on the root itself is only recomputed when one of its
+// captures lies in a changed region. Matches without captures have no
+// position and are not kept.
+//
+// Typical use mirrors incremental parsing:
+//   oldTree.edit(edit);
+//   runner.edit(edit);
+//   Tree newTree = parser.parseString(newSource, oldTree);
+//   runner.update(newTree, oldTree, newSource);
+class IncrementalQueryRunner {
+public:
+  explicit IncrementalQueryRunner(std::shared_ptr<const Query> query)
+    : query{std::move(query)}
+      { }
+
+  // Runs the query over the whole tree, discarding any cached matches.
+  // `source` is the text that the tree was parsed from, against which the
+  // query's text predicates are evaluated.
+  void
+  run(const Tree& tree, std::string_view source) {
+    matches.clear();
+    captures.clear();
+    dirty.clear();
+    Node root = tree.getRootNode();
+    execute(root, root.getByteRange(), {}, source, matches, captures);
+  }
+
+  // Moves cached matches to account for an edit of the source. Matches that
+  // overlap the edit are dropped and recomputed by the next update.
+  void
+  edit(const InputEdit& edit) {
+    removeMatches({edit.startByte, edit.oldEndByte});
+    for (CachedCapture& capture : captures) {
+      adjust(capture.range.start_byte, capture.range.start_point, edit);
+      adjust(capture.range.end_byte, capture.range.end_point, edit);
+    }
+    for (CachedMatch& match : matches) {
+      match.extent = getExtent(
+        std::span{captures}.subspan(match.firstCapture, match.numCaptures));
+    }
+    Point unused{};
+    for (Extent<uint32_t>& region : dirty) {
+      adjust(region.start, unused, edit);
+      adjust(region.end, unused, edit);
+    }
+    dirty.push_back({edit.startByte, edit.newEndByte});
+  }
+
+  // Brings the cached matches up to date with `tree`, which was reparsed
+  // from `oldTree` after the edits passed to edit(). `source` is the text
+  // that `tree` was parsed from.
+  void
+  update(const Tree& tree, const Tree& oldTree, std::string_view source) {
+    Ranges changed = tree.getChangedRanges(oldTree);
+    update(tree, std::span<const Range>{changed.begin(), changed.size()}, source);
+  }
+
+  // As above, given the changed ranges between the trees directly.
+  void
+  update(const Tree& tree,
+         std::span<const Range> changedRanges,
+         std::string_view source) {
+    for (const Range& range : changedRanges) {
+      dirty.push_back({range.start_byte, range.end_byte});
+    }
+    Node root = tree.getRootNode();
+    std::vector<Extent<uint32_t>> regions = getRegions(root);
+    dirty.clear();
+    if (regions.empty()) {
+      return;
+    }
+
+    // The regions are disjoint and sorted, so only the first region ending
+    // after the start of `extent` can overlap it.
+    auto intersectsRegions = [&regions](Extent<uint32_t> extent) {
+      auto candidate = std::upper_bound(regions.begin(), regions.end(), extent.start,
+        [](uint32_t offset, const Extent<uint32_t>& region) {
+          return offset < region.end;
+        });
+      return candidate != regions.end() && overlaps(extent, *candidate);
+    };
+
+    std::vector<CachedMatch> found;
+    std::vector<CachedCapture> foundCaptures;
+    for (size_t i = 0; i < regions.size(); ++i) {
+      std::span<const Extent<uint32_t>> earlier{regions.data(), i};
+      execute(root, regions[i], earlier, source, found, foundCaptures);
+    }
+
+    // Splice the new matches in place of the cached matches that they
+    // replace, keeping the matches ordered by position.
+    std::vector<CachedMatch> merged;
+    std::vector<CachedCapture> mergedCaptures;
+    merged.reserve(matches.size() + found.size());
+    mergedCaptures.reserve(captures.size() + foundCaptures.size());
+    auto append = [&merged, &mergedCaptures](const CachedMatch& match,
+                                             const std::vector<CachedCapture>& from) {
+      CachedMatch& added = merged.emplace_back(match);
+      added.firstCapture = static_cast<uint32_t>(mergedCaptures.size());
+      auto first = from.begin() + match.firstCapture;
+      mergedCaptures.insert(mergedCaptures.end(), first, first + match.numCaptures);
+    };
+    auto byPosition = [](const CachedMatch& a, const CachedMatch& b) {
+      return a.extent.start < b.extent.start;
+    };
+    std::stable_sort(found.begin(), found.end(), byPosition);
+    auto next = found.begin();
+    for (const CachedMatch& match : matches) {
+      if (intersectsRegions(match.extent)) {
+        continue;
+      }
+      for (; next != found.end() && byPosition(*next, match); ++next) {
+        append(*next, foundCaptures);
+      }
+      append(match, captures);
+    }
+    for (; next != found.end(); ++next) {
+      append(*next, foundCaptures);
+    }
+    matches = std::move(merged);
+    captures = std::move(mergedCaptures);
+  }
+
+  [[nodiscard]] std::span<const CachedMatch>
+  getMatches() const {
+    return matches;
+  }
+
+  [[nodiscard]] std::span<const CachedCapture>
+  getCaptures(const CachedMatch& match) const {
+    return std::span{captures}.subspan(match.firstCapture, match.numCaptures);
+  }
+
+  [[nodiscard]] const Query&
+  getQuery() const {
+    return *query;
+  }
+
+private:
+  // Whether two byte ranges overlap. Like QueryCursor::setByteRange, ranges
+  // are half open, so extents that only touch do not overlap, and a zero
+  // width extent only overlaps ranges that strictly contain it. Using the
+  // same test to drop cached matches and to keep found ones means that a
+  // match is only dropped when the query over its region can find it again.
+  static bool
+  overlaps(Extent<uint32_t> a, Extent<uint32_t> b) {
+    return a.start < b.end && b.start < a.end;
+  }
+
+  // Drops the cached matches that overlap `range`.
+  void
+  removeMatches(Extent<uint32_t> range) {
+    std::vector<CachedMatch> kept;
+    std::vector<CachedCapture> keptCaptures;
+    kept.reserve(matches.size());
+    keptCaptures.reserve(captures.size());
+    for (const CachedMatch& match : matches) {
+      if (overlaps(match.extent, range)) {
+        continue;
+      }
+      CachedMatch& added = kept.emplace_back(match);
+      added.firstCapture = static_cast<uint32_t>(keptCaptures.size());
+      auto first = captures.begin() + match.firstCapture;
+      keptCaptures.insert(keptCaptures.end(), first, first + match.numCaptures);
+    }
+    matches = std::move(kept);
+    captures = std::move(keptCaptures);
+  }
+
+  // Maps a position in the source before an edit to the position after it.
+  // Positions within the replaced text move to the start of the edit.
+  static void
+  adjust(uint32_t& byte, Point& point, const InputEdit& edit) {
+    if (byte < edit.startByte) {
+      return;
+    }
+    if (byte < edit.oldEndByte) {
+      byte = edit.startByte;
+      point = edit.startPoint;
+      return;
+    }
+    byte = byte - edit.oldEndByte + edit.newEndByte;
+    if (point.row == edit.oldEndPoint.row) {
+      point.column = point.column - edit.oldEndPoint.column + edit.newEndPoint.column;
+    }
+    point.row = point.row - edit.oldEndPoint.row + edit.newEndPoint.row;
+  }
+
+  static Extent<uint32_t>
+  getExtent(std::span<const CachedCapture> matchCaptures) {
+    Extent<uint32_t> extent{UINT32_MAX, 0};
+    for (const CachedCapture& capture : matchCaptures) {
+      extent.start = std::min(extent.start, capture.range.start_byte);
+      extent.end = std::max(extent.end, capture.range.end_byte);
+    }
+    return extent;
+  }
+
+  // Widens the dirty byte ranges to the children of the root that they
+  // touch, then sorts and merges them.
+  [[nodiscard]] std::vector<Extent<uint32_t>>
+  getRegions(Node root) const {
+    std::vector<Extent<uint32_t>> regions;
+    regions.reserve(dirty.size());
+    // Offsets between the children of the root are left as they are.
+    auto widen = [root](uint32_t offset) {
+      Node top = getTopLevel(root, root.getDescendantForByteRange({offset, offset}));
+      return top.getID() == root.getID() ? Extent<uint32_t>{offset, offset}
+                                         : top.getByteRange();
+    };
+    for (Extent<uint32_t> range : dirty) {
+      uint32_t last = range.end > range.start ? range.end - 1 : range.start;
+      regions.push_back({
+        std::min(range.start, widen(range.start).start),
+        std::max(range.end, widen(last).end)
+      });
+    }
+    std::sort(regions.begin(), regions.end(),
+      [](const Extent<uint32_t>& a, const Extent<uint32_t>& b) {
+        return a.start < b.start;
+      });
+    std::vector<Extent<uint32_t>> merged;
+    for (const Extent<uint32_t>& region : regions) {
+      if (!merged.empty() && region.start <= merged.back().end) {
+        merged.back().end = std::max(merged.back().end, region.end);
+      } else {
+        merged.push_back(region);
+      }
+    }
+    return merged;
+  }
+
+  // Finds the child of `root` containing `node`, or `root` itself.
+  static Node
+  getTopLevel(Node root, Node node) {
+    if (node.getID() == root.getID()) {
+      return node;
+    }
+    while (true) {
+      Node parent = node.getParent();
+      if (parent.isNull() || parent.getID() == root.getID()) {
+        return node;
+      }
+      node = parent;
+    }
+  }
+
+  // Runs the query over `region`, keeping the matches that intersect it but
+  // none of the `earlier` regions, which have already produced them.
+  void
+  execute(Node root,
+          Extent<uint32_t> region,
+          std::span<const Extent<uint32_t>> earlier,
+          std::string_view source,
+          std::vector<CachedMatch>& outMatches,
+          std::vector<CachedCapture>& outCaptures) const {
+    QueryCursor cursor;
+    cursor.setByteRange(region);
+    for (const Match& match : cursor.exec(*query, root, source)) {
+      if (match.getNumCaptures() == 0) {
+        continue;
+      }
+      auto first = static_cast<uint32_t>(outCaptures.size());
+      for (const Capture& capture : match.getCaptures()) {
+        outCaptures.push_back({capture.node.getRange(), capture.index});
+      }
+      std::span<const CachedCapture> added{outCaptures.begin() + first,
+                                           outCaptures.end()};
+      Extent<uint32_t> extent = getExtent(added);
+      bool isNew = overlaps(extent, region)
+        && std::none_of(earlier.begin(), earlier.end(),
+                        [&](const Extent<uint32_t>& other) {
+                          return overlaps(extent, other);
+                        });
+      if (!isNew) {
+        outCaptures.resize(first);
+        continue;
+      }
+      outMatches.push_back({match.getPatternIndex(), extent, first, match.getNumCaptures()});
+    }
+  }
+
+  std::shared_ptr<const Query> query;
+  std::vector<CachedMatch> matches;
+  std::vector<CachedCapture> captures;
+  // Byte ranges touched by edits since the last update, in the coordinates
+  // of the current source.
+  std::vector<Extent<uint32_t>> dirty;
+};
+
+
+}
+
+#endif
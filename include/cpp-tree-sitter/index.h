@@ -0,0 +1,360 @@
+#ifndef CPP_TREE_SITTER_INDEX_H
+#define CPP_TREE_SITTER_INDEX_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <cpp-tree-sitter.h>
+#include <cpp-tree-sitter/query.h>
+#include <cpp-tree-sitter/parallel.h>
+
+namespace ts {
+
+
+namespace detail {
+
+// Append only storage for interned strings. Stored strings never move, so
+// views of them stay valid for the lifetime of the arena.
+class StringArena {
+public:
+  [[nodiscard]] std::string_view
+  store(std::string_view text) {
+    if (text.size() > BLOCK_SIZE / 4) {
+      // Large strings get their own blocks rather than wasting the rest of
+      // the current one.
+      auto& block = blocks.emplace_back(new char[text.size()]);
+      std::memcpy(block.get(), text.data(), text.size());
+      numBytes += text.size();
+      return {block.get(), text.size()};
+    }
+    if (remaining < text.size()) {
+      next = blocks.emplace_back(new char[BLOCK_SIZE]).get();
+      remaining = BLOCK_SIZE;
+      numBytes += BLOCK_SIZE;
+    }
+    std::memcpy(next, text.data(), text.size());
+    std::string_view stored{next, text.size()};
+    next += text.size();
+    remaining -= text.size();
+    return stored;
+  }
+
+  // The number of bytes allocated by the arena.
+  [[nodiscard]] size_t
+  getNumBytes() const {
+    return numBytes;
+  }
+
+private:
+  static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+  std::vector<std::unique_ptr<char[]>> blocks;
+  char* next = nullptr;
+  size_t remaining = 0;
+  size_t numBytes = 0;
+};
+
+// Assigns dense ids to strings, storing each distinct string once.
+class StringInterner {
+public:
+  [[nodiscard]] uint32_t
+  intern(std::string_view text) {
+    if (auto found = ids.find(text); found != ids.end()) {
+      return found->second;
+    }
+    std::string_view stored = arena.store(text);
+    auto id = static_cast<uint32_t>(strings.size());
+    strings.push_back(stored);
+    ids.emplace(stored, id);
+    return id;
+  }
+
+  [[nodiscard]] std::optional<uint32_t>
+  lookup(std::string_view text) const {
+    if (auto found = ids.find(text); found != ids.end()) {
+      return found->second;
+    }
+    return std::nullopt;
+  }
+
+  [[nodiscard]] std::string_view
+  get(uint32_t id) const {
+    return strings[id];
+  }
+
+  [[nodiscard]] size_t
+  size() const {
+    return strings.size();
+  }
+
+  [[nodiscard]] size_t
+  getNumBytes() const {
+    return arena.getNumBytes();
+  }
+
+private:
+  StringArena arena;
+  std::vector<std::string_view> strings;
+  std::unordered_map<std::string_view, uint32_t> ids;
+};
+
+}
+
+
+// An index from identifier text to its occurrences across many files, built
+// from the captures of a query. Every capture of the query is recorded as a
+// Posting for the text that it captured, with the capture's index as its
+// kind, so a query such as
+//   (function_definition declarator: (identifier) @definition)
+//   (call_expression function: (identifier) @reference)
+// yields definitions and references that are told apart by capture name.
+//
+// Identifier text and file paths are interned, and each identifier's
+// postings are kept in one array sorted by file and position. Updating a
+// file replaces only the postings from that file. Interned identifiers are
+// kept even once no file uses them.
+//
+// An Index is not thread safe, although updateFiles parses and queries
+// files on many threads internally.
+class Index {
+public:
+  using FileID = uint32_t;
+  using NameID = uint32_t;
+
+  struct Posting {
+    FileID file;
+    uint32_t captureIndex;
+    Extent<uint32_t> bytes;
+  };
+
+  explicit Index(std::shared_ptr<const Query> query)
+    : query{std::move(query)}
+      { }
+
+  Index(const Index& other) = delete;
+  Index& operator=(const Index& other) = delete;
+  Index(Index&& other) = default;
+  Index& operator=(Index&& other) = default;
+
+  ////////////////////////////////////////////////////////////////
+  // Updates
+  ////////////////////////////////////////////////////////////////
+
+  // Replaces the postings of the file at `path` with the captures of the
+  // query over `tree`, which was parsed from `source`.
+  void
+  update(std::string_view path, const Tree& tree, std::string_view source) {
+    std::vector<Occurrence> occurrences = collect(tree, source);
+    apply(files.intern(path), occurrences);
+  }
+
+  // Parses the files at `paths` with `parser` and updates each of them as
+  // above. Parsing and querying happen on the parser's worker threads. If
+  // any file cannot be read, the first such exception is rethrown after the
+  // other files have been updated.
+  void
+  updateFiles(ParallelParser& parser, std::span<const std::filesystem::path> paths) {
+    std::mutex mutex;
+    parser.parseFiles(paths, [this, &mutex, paths](size_t index, MappedTree parsed) {
+      std::vector<Occurrence> occurrences = collect(parsed.tree, parsed.getSource());
+      std::lock_guard lock{mutex};
+      apply(files.intern(paths[index].string()), occurrences);
+    });
+  }
+
+  // Removes all postings from the file at `path`.
+  void
+  remove(std::string_view path) {
+    if (auto file = files.lookup(path)) {
+      removePostings(*file);
+    }
+  }
+
+  ////////////////////////////////////////////////////////////////
+  // Lookup
+  ////////////////////////////////////////////////////////////////
+
+  // Returns the occurrences of `name`, sorted by file and then by position.
+  [[nodiscard]] std::span<const Posting>
+  find(std::string_view name) const {
+    if (auto id = names.lookup(name)) {
+      return postings[*id];
+    }
+    return {};
+  }
+
+  // Returns the occurrences of `name` within `file`, sorted by position.
+  [[nodiscard]] std::span<const Posting>
+  find(std::string_view name, FileID file) const {
+    std::span<const Posting> all = find(name);
+    auto [first, last] = std::equal_range(all.begin(), all.end(), file, ByFile{});
+    return {first, last};
+  }
+
+  [[nodiscard]] std::optional<NameID>
+  getNameID(std::string_view name) const {
+    return names.lookup(name);
+  }
+
+  [[nodiscard]] std::string_view
+  getName(NameID name) const {
+    return names.get(name);
+  }
+
+  [[nodiscard]] std::span<const Posting>
+  getPostings(NameID name) const {
+    return postings[name];
+  }
+
+  [[nodiscard]] std::optional<FileID>
+  getFileID(std::string_view path) const {
+    return files.lookup(path);
+  }
+
+  [[nodiscard]] std::string_view
+  getPath(FileID file) const {
+    return files.get(file);
+  }
+
+  // The distinct names in a file, sorted by NameID.
+  [[nodiscard]] std::span<const NameID>
+  getNamesInFile(FileID file) const {
+    return file < namesByFile.size() ? std::span<const NameID>{namesByFile[file]}
+                                     : std::span<const NameID>{};
+  }
+
+  [[nodiscard]] std::string_view
+  getCaptureName(const Posting& posting) const {
+    return query->getCaptureName(posting.captureIndex);
+  }
+
+  [[nodiscard]] size_t
+  getNumNames() const {
+    return names.size();
+  }
+
+  [[nodiscard]] size_t
+  getNumFiles() const {
+    return files.size();
+  }
+
+  // The number of bytes used to store interned names and paths.
+  [[nodiscard]] size_t
+  getNumStringBytes() const {
+    return names.getNumBytes() + files.getNumBytes();
+  }
+
+private:
+  // A capture found in a file, referring to the file's source text.
+  struct Occurrence {
+    std::string_view text;
+    uint32_t captureIndex;
+    Extent<uint32_t> bytes;
+  };
+
+  struct ByFile {
+    bool operator()(const Posting& posting, FileID file) const { return posting.file < file; }
+    bool operator()(FileID file, const Posting& posting) const { return file < posting.file; }
+  };
+
+  // Safe to call from several threads at once, as it only reads the query.
+  [[nodiscard]] std::vector<Occurrence>
+  collect(const Tree& tree, std::string_view source) const {
+    std::vector<Occurrence> occurrences;
+    QueryCursor cursor;
+    for (const Match& match : cursor.exec(*query, tree.getRootNode(), source)) {
+      for (const Capture& capture : match.getCaptures()) {
+        Extent<uint32_t> bytes = capture.node.getByteRange();
+        if (bytes.start == bytes.end) {
+          continue;
+        }
+        occurrences.push_back({capture.node.getSourceRange(source),
+                               capture.index,
+                               bytes});
+      }
+    }
+    return occurrences;
+  }
+
+  void
+  apply(FileID file, std::span<const Occurrence> occurrences) {
+    removePostings(file);
+
+    std::vector<std::pair<NameID, Posting>> added;
+    added.reserve(occurrences.size());
+    for (const Occurrence& occurrence : occurrences) {
+      NameID name = names.intern(occurrence.text);
+      added.push_back({name, Posting{file, occurrence.captureIndex, occurrence.bytes}});
+    }
+    postings.resize(names.size());
+    std::sort(added.begin(), added.end(), [](const auto& a, const auto& b) {
+      return std::tie(a.first, a.second.bytes.start, a.second.bytes.end, a.second.captureIndex)
+           < std::tie(b.first, b.second.bytes.start, b.second.bytes.end, b.second.captureIndex);
+    });
+    // Matches of several patterns may capture the same node the same way.
+    added.erase(std::unique(added.begin(), added.end(), [](const auto& a, const auto& b) {
+      return a.first == b.first
+          && a.second.captureIndex == b.second.captureIndex
+          && a.second.bytes.start == b.second.bytes.start
+          && a.second.bytes.end == b.second.bytes.end;
+    }), added.end());
+
+    if (file >= namesByFile.size()) {
+      namesByFile.resize(file + 1);
+    }
+    std::vector<NameID>& fileNames = namesByFile[file];
+    for (auto group = added.begin(); group != added.end();) {
+      NameID name = group->first;
+      auto groupEnd = std::find_if(group, added.end(),
+        [name](const auto& entry) { return entry.first != name; });
+      std::vector<Posting>& list = postings[name];
+      auto position = std::lower_bound(list.begin(), list.end(), file, ByFile{});
+      std::vector<Posting> inserted;
+      inserted.reserve(static_cast<size_t>(groupEnd - group));
+      for (auto entry = group; entry != groupEnd; ++entry) {
+        inserted.push_back(entry->second);
+      }
+      list.insert(position, inserted.begin(), inserted.end());
+      fileNames.push_back(name);
+      group = groupEnd;
+    }
+  }
+
+  void
+  removePostings(FileID file) {
+    if (file >= namesByFile.size()) {
+      return;
+    }
+    for (NameID name : namesByFile[file]) {
+      std::vector<Posting>& list = postings[name];
+      auto [first, last] = std::equal_range(list.begin(), list.end(), file, ByFile{});
+      list.erase(first, last);
+    }
+    namesByFile[file].clear();
+  }
+
+  std::shared_ptr<const Query> query;
+  detail::StringInterner names;
+  detail::StringInterner files;
+  // The postings of each name, sorted by file and then by position.
+  std::vector<std::vector<Posting>> postings;
+  // The distinct names in each file, sorted.
+  std::vector<std::vector<NameID>> namesByFile;
+};
+
+
+}
+
+#endif
@@ -0,0 +1,182 @@
+#ifndef CPP_TREE_SITTER_LANGUAGE_REGISTRY_H
+#define CPP_TREE_SITTER_LANGUAGE_REGISTRY_H
+
+#include <cctype>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(_WIN32)
+  #ifndef WIN32_LEAN_AND_MEAN
+    #define WIN32_LEAN_AND_MEAN
+  #endif
+  #ifndef NOMINMAX
+    #define NOMINMAX
+  #endif
+  #include <windows.h>
+#else
+  #include <dlfcn.h>
+#endif
+
+#include <cpp-tree-sitter.h>
+
+// Dynamic loading pulls in platform headers and libraries, so the registry
+// lives in its own header. Grammars built with `add_grammar_from_repo(...
+// SHARED)` are suitable for loading through it.
+
+namespace ts {
+
+
+// Thrown when a registered grammar cannot be loaded.
+class LanguageLoadError : public std::runtime_error {
+public:
+  using std::runtime_error::runtime_error;
+};
+
+
+// A thread safe registry of grammars in shared libraries, keyed by name.
+// A grammar's library is only loaded the first time that the grammar is
+// requested, so processes pay only for the grammars that they use. Loaded
+// libraries are never unloaded, as Languages from them may be held anywhere.
+class LanguageRegistry {
+public:
+  LanguageRegistry() = default;
+  LanguageRegistry(const LanguageRegistry& other) = delete;
+  LanguageRegistry& operator=(const LanguageRegistry& other) = delete;
+
+  // A process wide registry for services that have no natural owner for one.
+  [[nodiscard]] static LanguageRegistry&
+  getGlobal() {
+    static LanguageRegistry registry;
+    return registry;
+  }
+
+  // Registers the grammar `name` as provided by the library at `library`.
+  // The library must export `symbol`, the grammar's language function, which
+  // defaults to `tree_sitter_<name>` with non-alphanumeric characters
+  // replaced by `_`. Registering a name again replaces it unless it has
+  // already been loaded.
+  void
+  add(std::string name,
+      std::filesystem::path library,
+      std::optional<std::string> symbol = std::nullopt) {
+    std::string function = symbol ? std::move(*symbol) : getDefaultSymbol(name);
+    std::lock_guard lock{mutex};
+    Entry& entry = entries[std::move(name)];
+    if (!entry.language) {
+      entry.library = std::move(library);
+      entry.symbol = std::move(function);
+    }
+  }
+
+  // Registers a grammar that is linked into the program, such as
+  // `add("json", tree_sitter_json())`.
+  void
+  add(std::string name, Language language) {
+    std::lock_guard lock{mutex};
+    Entry& entry = entries[std::move(name)];
+    if (!entry.language) {
+      entry.language = language.impl;
+    }
+  }
+
+  [[nodiscard]] bool
+  contains(std::string_view name) const {
+    std::lock_guard lock{mutex};
+    return entries.find(name) != entries.end();
+  }
+
+  [[nodiscard]] bool
+  isLoaded(std::string_view name) const {
+    std::lock_guard lock{mutex};
+    auto found = entries.find(name);
+    return found != entries.end() && found->second.language;
+  }
+
+  // Returns the grammar `name`, loading its library on first use. Throws
+  // std::out_of_range if no such grammar is registered and LanguageLoadError
+  // if its library or language function cannot be found.
+  [[nodiscard]] Language
+  get(std::string_view name) {
+    std::lock_guard lock{mutex};
+    auto found = entries.find(name);
+    if (found == entries.end()) {
+      throw std::out_of_range{"No grammar registered as " + std::string{name}};
+    }
+    Entry& entry = found->second;
+    if (!entry.language) {
+      entry.language = load(entry.library, entry.symbol);
+    }
+    return entry.language;
+  }
+
+  [[nodiscard]] std::vector<std::string>
+  getNames() const {
+    std::lock_guard lock{mutex};
+    std::vector<std::string> names;
+    names.reserve(entries.size());
+    for (const auto& [name, entry] : entries) {
+      names.push_back(name);
+    }
+    return names;
+  }
+
+private:
+  struct Entry {
+    std::filesystem::path library;
+    std::string symbol;
+    TSLanguage const* language = nullptr;
+  };
+
+  static std::string
+  getDefaultSymbol(std::string_view name) {
+    std::string symbol = "tree_sitter_";
+    for (char c : name) {
+      symbol.push_back(std::isalnum(static_cast<unsigned char>(c)) ? c : '_');
+    }
+    return symbol;
+  }
+
+  using LanguageFunction = TSLanguage const* (*)();
+
+  static TSLanguage const*
+  load(const std::filesystem::path& library, const std::string& symbol) {
+#if defined(_WIN32)
+    HMODULE handle = LoadLibraryW(library.c_str());
+    if (!handle) {
+      throw LanguageLoadError{"Unable to load " + library.string()};
+    }
+    auto address = GetProcAddress(handle, symbol.c_str());
+    if (!address) {
+      FreeLibrary(handle);
+      throw LanguageLoadError{library.string() + " does not define " + symbol};
+    }
+#else
+    void* handle = dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!handle) {
+      throw LanguageLoadError{dlerror()};
+    }
+    void* address = dlsym(handle, symbol.c_str());
+    if (!address) {
+      dlclose(handle);
+      throw LanguageLoadError{library.string() + " does not define " + symbol};
+    }
+#endif
+    auto function = reinterpret_cast<LanguageFunction>(address);
+    return function();
+  }
+
+  mutable std::mutex mutex;
+  std::map<std::string, Entry, std::less<>> entries;
+};
+
+
+}
+
+#endif
@@ -0,0 +1,174 @@
+#ifndef CPP_TREE_SITTER_MAPPED_SOURCE_H
+#define CPP_TREE_SITTER_MAPPED_SOURCE_H
+
+#include <cerrno>
+#include <filesystem>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+#if defined(_WIN32)
+  #ifndef WIN32_LEAN_AND_MEAN
+    #define WIN32_LEAN_AND_MEAN
+  #endif
+  #ifndef NOMINMAX
+    #define NOMINMAX
+  #endif
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+#include <cpp-tree-sitter.h>
+
+// Platform specific headers are kept out of cpp-tree-sitter.h, so file
+// mapping support lives in its own header.
+
+namespace ts {
+
+
+// A read-only memory mapping of a source file. The contents remain valid for
+// the lifetime of the MappedSource and are backed directly by the page cache,
+// so no copy of the file is made.
+class MappedSource {
+public:
+  // Throws std::system_error if the file cannot be opened or mapped.
+  explicit MappedSource(const std::filesystem::path& path) {
+#if defined(_WIN32)
+    HANDLE file = CreateFileW(path.c_str(),
+                              GENERIC_READ,
+                              FILE_SHARE_READ,
+                              nullptr,
+                              OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+                              nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+      throwLastError("CreateFileW");
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize)) {
+      CloseHandle(file);
+      throwLastError("GetFileSizeEx");
+    }
+    length = static_cast<size_t>(fileSize.QuadPart);
+    if (length == 0) {
+      CloseHandle(file);
+      return;
+    }
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (!mapping) {
+      throwLastError("CreateFileMappingW");
+    }
+    // The view keeps the mapping alive, so the handle can be closed now.
+    data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    CloseHandle(mapping);
+    if (!data) {
+      throwLastError("MapViewOfFile");
+    }
+#else
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      throwLastError("open");
+    }
+    struct stat status;
+    if (::fstat(fd, &status) != 0) {
+      ::close(fd);
+      throwLastError("fstat");
+    }
+    length = static_cast<size_t>(status.st_size);
+    if (length == 0) {
+      ::close(fd);
+      return;
+    }
+    void* mapped = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+      throwLastError("mmap");
+    }
+    // Parsing reads the source front to back, so favor aggressive read ahead.
+    // This is only a hint, so failures are ignored.
+    ::madvise(mapped, length, MADV_SEQUENTIAL);
+    data = static_cast<const char*>(mapped);
+#endif
+  }
+
+  MappedSource(const MappedSource& other) = delete;
+  MappedSource(MappedSource&& other)
+    : data{std::exchange(other.data, nullptr)},
+      length{std::exchange(other.length, 0)}
+      { }
+  MappedSource& operator=(const MappedSource& other) = delete;
+  MappedSource& operator=(MappedSource&& other) {
+    std::swap(data, other.data);
+    std::swap(length, other.length);
+    return *this;
+  }
+
+  ~MappedSource() {
+    if (!data) {
+      return;
+    }
+#if defined(_WIN32)
+    UnmapViewOfFile(data);
+#else
+    ::munmap(const_cast<char*>(data), length);
+#endif
+  }
+
+  [[nodiscard]] std::string_view
+  getContents() const {
+    return {data, length};
+  }
+
+  [[nodiscard]] size_t
+  size() const {
+    return length;
+  }
+
+private:
+  [[noreturn]] static void
+  throwLastError(const char* operation) {
+#if defined(_WIN32)
+    int code = static_cast<int>(GetLastError());
+#else
+    int code = errno;
+#endif
+    throw std::system_error{code, std::system_category(), operation};
+  }
+
+  const char* data = nullptr;
+  size_t length = 0;
+};
+
+
+// A parse tree together with the mapped source that it was parsed from, so
+// that Node::getSourceRange can be used for as long as the tree is alive.
+struct MappedTree {
+  MappedSource source;
+  Tree tree;
+
+  [[nodiscard]] std::string_view
+  getSource() const {
+    return source.getContents();
+  }
+};
+
+
+// Maps the file at `path` into memory and parses it directly from the mapping.
+// Throws std::system_error if the file cannot be mapped and ParseStoppedError
+// if the parser's timeout or cancellation token stops the parse.
+[[nodiscard]] inline MappedTree
+parseFile(Parser& parser, const std::filesystem::path& path) {
+  MappedSource source{path};
+  Tree tree = parser.parseString(source.getContents());
+  return MappedTree{std::move(source), std::move(tree)};
+}
+
+
+}
+
+#endif
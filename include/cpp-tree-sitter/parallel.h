@@ -0,0 +1,337 @@
+#ifndef CPP_TREE_SITTER_PARALLEL_H
+#define CPP_TREE_SITTER_PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <cpp-tree-sitter.h>
+#include <cpp-tree-sitter/mapped-source.h>
+
+namespace ts {
+
+
+template <typename Sources>
+concept SourceRange =
+  std::ranges::random_access_range<Sources>
+  && std::ranges::sized_range<Sources>
+  && std::convertible_to<std::ranges::range_reference_t<Sources>,
+                         std::string_view>;
+
+
+// Parses many inputs of a single language in parallel. Each worker thread owns
+// its own Parser, which is retained across batches. Inputs are dealt to the
+// workers largest first, and idle workers steal from the queues of busy ones
+// so that a few very large inputs do not leave the remaining threads idle.
+//
+// A ParallelParser itself may only run one batch at a time.
+class ParallelParser {
+public:
+  explicit ParallelParser(Language language,
+                          size_t numThreads = std::thread::hardware_concurrency()) {
+    parsers.reserve(std::max<size_t>(numThreads, 1));
+    for (size_t i = 0, e = std::max<size_t>(numThreads, 1); i < e; ++i) {
+      parsers.emplace_back(language);
+    }
+  }
+
+  [[nodiscard]] size_t
+  getNumThreads() const {
+    return parsers.size();
+  }
+
+  // Parses every source and passes each resulting tree to
+  // `callback(size_t index, Tree tree)`. The callback is invoked concurrently
+  // from the worker threads, so it must be thread safe.
+  template <SourceRange Sources, typename Callback>
+  void
+  parse(const Sources& sources, Callback&& callback) {
+    auto size = [&sources](size_t index) {
+      return std::string_view{std::ranges::begin(sources)[index]}.size();
+    };
+    run(std::ranges::size(sources), size,
+      [&sources, &callback](Parser& parser, size_t index) {
+        std::string_view source{std::ranges::begin(sources)[index]};
+        callback(index, parser.parseString(source));
+      });
+  }
+
+  // Parses every source and returns the trees in input order.
+  template <SourceRange Sources>
+  [[nodiscard]] std::vector<Tree>
+  parse(const Sources& sources) {
+    std::vector<std::optional<Tree>> results(std::ranges::size(sources));
+    parse(sources, [&results](size_t index, Tree tree) {
+      results[index].emplace(std::move(tree));
+    });
+    return unwrap(std::move(results));
+  }
+
+  // Maps and parses every file and passes each result to
+  // `callback(size_t index, MappedTree tree)` from the worker threads.
+  // If any file cannot be mapped, the first such error is rethrown once all
+  // workers have stopped.
+  template <typename Callback>
+  void
+  parseFiles(std::span<const std::filesystem::path> paths, Callback&& callback) {
+    auto size = [paths](size_t index) {
+      std::error_code error;
+      auto fileSize = std::filesystem::file_size(paths[index], error);
+      return error ? 0 : static_cast<size_t>(fileSize);
+    };
+    run(paths.size(), size,
+      [paths, &callback](Parser& parser, size_t index) {
+        callback(index, parseFile(parser, paths[index]));
+      });
+  }
+
+  // Maps and parses every file and returns the results in input order.
+  [[nodiscard]] std::vector<MappedTree>
+  parseFiles(std::span<const std::filesystem::path> paths) {
+    std::vector<std::optional<MappedTree>> results(paths.size());
+    parseFiles(paths, [&results](size_t index, MappedTree tree) {
+      results[index].emplace(std::move(tree));
+    });
+    return unwrap(std::move(results));
+  }
+
+private:
+  struct WorkQueue {
+    std::mutex mutex;
+    std::deque<size_t> indices;
+  };
+
+  template <typename T>
+  static std::vector<T>
+  unwrap(std::vector<std::optional<T>> wrapped) {
+    std::vector<T> results;
+    results.reserve(wrapped.size());
+    for (auto& result : wrapped) {
+      results.push_back(std::move(*result));
+    }
+    return results;
+  }
+
+  // Runs `task(Parser&, size_t index)` for every index in [0, count), using
+  // `weight(index)` as an estimate of the cost of each task.
+  template <typename Weight, typename Task>
+  void
+  run(size_t count, Weight&& weight, Task&& task) {
+    std::vector<size_t> order(count);
+    std::iota(order.begin(), order.end(), 0);
+    std::vector<size_t> weights(count);
+    for (size_t index = 0; index < count; ++index) {
+      weights[index] = weight(index);
+    }
+    std::stable_sort(order.begin(), order.end(),
+      [&weights](size_t a, size_t b) { return weights[a] > weights[b]; });
+
+    size_t numWorkers = std::min(parsers.size(), std::max<size_t>(count, 1));
+    std::vector<WorkQueue> queues(numWorkers);
+    for (size_t position = 0; position < count; ++position) {
+      queues[position % numWorkers].indices.push_back(order[position]);
+    }
+
+    std::mutex errorMutex;
+    std::exception_ptr firstError;
+
+    auto worker = [&](size_t self) {
+      Parser& parser = parsers[self];
+      while (auto index = takeWork(queues, self)) {
+        try {
+          task(parser, *index);
+        } catch (...) {
+          std::lock_guard lock{errorMutex};
+          if (!firstError) {
+            firstError = std::current_exception();
+          }
+        }
+      }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(numWorkers - 1);
+    for (size_t self = 1; self < numWorkers; ++self) {
+      threads.emplace_back(worker, self);
+    }
+    // The calling thread acts as the first worker.
+    worker(0);
+    for (auto& thread : threads) {
+      thread.join();
+    }
+
+    if (firstError) {
+      std::rethrow_exception(firstError);
+    }
+  }
+
+  // Takes the next task from the front of a worker's own queue or steals one
+  // from the back of another worker's queue. Because no work is added once a
+  // batch starts, finding every queue empty means the batch is done.
+  static std::optional<size_t>
+  takeWork(std::vector<WorkQueue>& queues, size_t self) {
+    {
+      WorkQueue& own = queues[self];
+      std::lock_guard lock{own.mutex};
+      if (!own.indices.empty()) {
+        size_t index = own.indices.front();
+        own.indices.pop_front();
+        return index;
+      }
+    }
+    for (size_t offset = 1; offset < queues.size(); ++offset) {
+      WorkQueue& victim = queues[(self + offset) % queues.size()];
+      std::lock_guard lock{victim.mutex};
+      if (!victim.indices.empty()) {
+        size_t index = victim.indices.back();
+        victim.indices.pop_back();
+        return index;
+      }
+    }
+    return std::nullopt;
+  }
+
+  std::vector<Parser> parsers;
+};
+
+
+
+// A unit of work within a tree: a run of consecutive sibling subtrees. The run
+// starts at the node with the given preorder descendant index from the root
+// of the tree, so that it can be located again within any clone of the tree.
+struct WorkUnit {
+  uint32_t descendantIndex;
+  uint32_t numSiblings;
+  // The total number of nodes in the subtrees of the run.
+  uint32_t numNodes;
+};
+
+
+// Splits a tree into disjoint runs of sibling subtrees of roughly `targetNodes`
+// nodes each, in tree order. Subtrees larger than the target are split among
+// their children, so the ancestors of those children are not part of any
+// unit. A tree with at most `targetNodes` nodes forms a single unit. A target
+// of 0 is treated as 1, making every leaf its own unit.
+[[nodiscard]] inline std::vector<WorkUnit>
+partition(const Tree& tree, size_t targetNodes) {
+  // Every subtree has at least one node, so with a target of 0 every subtree
+  // would be split and no units would remain.
+  targetNodes = std::max<size_t>(targetNodes, 1);
+  Node root = tree.getRootNode();
+  if (root.getNumDescendants() <= targetNodes) {
+    return {WorkUnit{0, 1, root.getNumDescendants()}};
+  }
+
+  std::vector<WorkUnit> units;
+  std::vector<uint32_t> oversized{0};
+  Cursor cursor = root.getCursor();
+  while (!oversized.empty()) {
+    cursor.reset(root);
+    cursor.gotoDescendant(oversized.back());
+    oversized.pop_back();
+    if (!cursor.gotoFirstChild()) {
+      continue;
+    }
+
+    std::optional<WorkUnit> run;
+    auto flush = [&run, &units]() {
+      if (run) {
+        units.push_back(*run);
+        run.reset();
+      }
+    };
+    do {
+      uint32_t index = cursor.getCurrentDescendantIndex();
+      uint32_t numNodes = cursor.getCurrentNode().getNumDescendants();
+      if (numNodes > targetNodes) {
+        flush();
+        oversized.push_back(index);
+        continue;
+      }
+      if (!run) {
+        run = WorkUnit{index, 0, 0};
+      }
+      ++run->numSiblings;
+      run->numNodes += numNodes;
+      if (run->numNodes >= targetNodes) {
+        flush();
+      }
+    } while (cursor.gotoNextSibling());
+    flush();
+  }
+
+  std::sort(units.begin(), units.end(),
+    [](const WorkUnit& a, const WorkUnit& b) {
+      return a.descendantIndex < b.descendantIndex;
+    });
+  return units;
+}
+
+
+// Calls `callback(Node)` for the root of every subtree in `units` using
+// `numThreads` threads. Each thread reads its own clone of the tree, so the
+// nodes passed to the callback are only valid during the call. If a callback
+// throws, the first exception is rethrown once all threads have stopped.
+template <typename Callback>
+void
+forEachSubtree(const SharedTree& tree,
+               std::span<const WorkUnit> units,
+               Callback&& callback,
+               size_t numThreads = std::thread::hardware_concurrency()) {
+  std::atomic<size_t> next{0};
+  std::mutex errorMutex;
+  std::exception_ptr firstError;
+
+  auto worker = [&]() {
+    Tree local = tree.clone();
+    Node root = local.getRootNode();
+    Cursor cursor = root.getCursor();
+    for (size_t unit = next++; unit < units.size(); unit = next++) {
+      try {
+        cursor.reset(root);
+        cursor.gotoDescendant(units[unit].descendantIndex);
+        for (uint32_t sibling = 0; sibling < units[unit].numSiblings; ++sibling) {
+          if (sibling > 0 && !cursor.gotoNextSibling()) {
+            break;
+          }
+          callback(cursor.getCurrentNode());
+        }
+      } catch (...) {
+        std::lock_guard lock{errorMutex};
+        if (!firstError) {
+          firstError = std::current_exception();
+        }
+      }
+    }
+  };
+
+  size_t numWorkers = std::clamp<size_t>(numThreads, 1, std::max<size_t>(units.size(), 1));
+  std::vector<std::thread> threads;
+  threads.reserve(numWorkers - 1);
+  for (size_t i = 1; i < numWorkers; ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  if (firstError) {
+    std::rethrow_exception(firstError);
+  }
+}
+
+
+}
+
+#endif
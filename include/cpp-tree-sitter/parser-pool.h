@@ -0,0 +1,115 @@
+#ifndef CPP_TREE_SITTER_PARSER_POOL_H
+#define CPP_TREE_SITTER_PARSER_POOL_H
+
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <cpp-tree-sitter.h>
+
+namespace ts {
+
+
+// A thread safe pool of configured parsers, keyed by language. Acquiring a
+// parser yields a Lease that returns the parser to the pool when destroyed,
+// so repeated short parses avoid the cost of creating and configuring a new
+// parser each time. At most `maxIdlePerLanguage` parsers of each language are
+// retained; parsers returned beyond that limit are destroyed.
+//
+// Returned parsers are reset and restored to their default options, so
+// a lease always starts from a parser with no timeout, token, included
+// ranges, logger, or observer.
+//
+// The pool must outlive all of its leases.
+class ParserPool {
+public:
+  class Lease {
+  public:
+    Lease(const Lease& other) = delete;
+    Lease(Lease&& other)
+      : pool{std::exchange(other.pool, nullptr)},
+        parser{std::move(other.parser)}
+        { }
+    Lease& operator=(const Lease& other) = delete;
+    Lease& operator=(Lease&& other) {
+      std::swap(pool, other.pool);
+      std::swap(parser, other.parser);
+      return *this;
+    }
+
+    ~Lease() {
+      if (pool && parser) {
+        pool->release(std::move(*parser));
+      }
+    }
+
+    [[nodiscard]] Parser& operator*() { return *parser; }
+    [[nodiscard]] Parser* operator->() { return &*parser; }
+
+  private:
+    friend class ParserPool;
+
+    Lease(ParserPool& pool, Parser parser)
+      : pool{&pool},
+        parser{std::move(parser)}
+        { }
+
+    ParserPool* pool;
+    std::optional<Parser> parser;
+  };
+
+  explicit ParserPool(size_t maxIdlePerLanguage = 8)
+    : maxIdlePerLanguage{maxIdlePerLanguage}
+      { }
+
+  // Returns an idle parser for `language`, creating one if none is available.
+  [[nodiscard]] Lease
+  acquire(Language language) {
+    {
+      std::lock_guard lock{mutex};
+      auto found = idle.find(language.impl);
+      if (found != idle.end() && !found->second.empty()) {
+        Parser parser = std::move(found->second.back());
+        found->second.pop_back();
+        return Lease{*this, std::move(parser)};
+      }
+    }
+    return Lease{*this, Parser{language}};
+  }
+
+  [[nodiscard]] size_t
+  getNumIdle() const {
+    std::lock_guard lock{mutex};
+    size_t count = 0;
+    for (const auto& [language, parsers] : idle) {
+      count += parsers.size();
+    }
+    return count;
+  }
+
+private:
+  void
+  release(Parser parser) {
+    // Resetting outside of the lock keeps the critical section short. The
+    // next lessee must not see the options of this one, which may refer to
+    // tokens, loggers, or observers that no longer exist.
+    parser.reset();
+    parser.restoreDefaults();
+    std::lock_guard lock{mutex};
+    auto& parsers = idle[parser.getLanguage().impl];
+    if (parsers.size() < maxIdlePerLanguage) {
+      parsers.push_back(std::move(parser));
+    }
+  }
+
+  size_t maxIdlePerLanguage;
+  mutable std::mutex mutex;
+  std::unordered_map<TSLanguage const*, std::vector<Parser>> idle;
+};
+
+
+}
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef CPP_TREE_SITTER_QUERY_CACHE_H
+#define CPP_TREE_SITTER_QUERY_CACHE_H
+
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include <cpp-tree-sitter.h>
+#include <cpp-tree-sitter/query.h>
+
+namespace ts {
+
+
+struct QueryCacheStats {
+  size_t hits;
+  size_t misses;
+  size_t evictions;
+};
+
+
+// A thread safe cache of compiled queries keyed by language and query source.
+// Cached queries are shared and immutable, so they may be used from any
+// number of threads at once. When the cache is full, the least recently used
+// query is evicted; handles to it remain valid until they are released.
+class QueryCache {
+public:
+  explicit QueryCache(size_t capacity = 64)
+    : capacity{capacity}
+      { }
+
+  QueryCache(const QueryCache& other) = delete;
+  QueryCache& operator=(const QueryCache& other) = delete;
+
+  // A process wide cache for services that have no natural owner for one.
+  [[nodiscard]] static QueryCache&
+  getGlobal() {
+    static QueryCache cache;
+    return cache;
+  }
+
+  // Returns the compiled query for `source`, compiling it on a miss.
+  // Throws QueryCompilationError if `source` is not a valid query, in which
+  // case nothing is cached.
+  [[nodiscard]] std::shared_ptr<const Query>
+  get(Language language, std::string_view source) {
+    Key key{language.impl, source};
+    {
+      std::lock_guard lock{mutex};
+      if (auto found = entries.find(key); found != entries.end()) {
+        ++stats.hits;
+        recent.splice(recent.begin(), recent, found->second);
+        return found->second->query;
+      }
+      ++stats.misses;
+    }
+
+    // Compilation can take a long time for large queries, so it happens
+    // outside of the lock. If another thread compiled the same query in the
+    // meantime, its result is used instead.
+    auto compiled = std::make_shared<const Query>(language, source);
+
+    std::lock_guard lock{mutex};
+    if (auto found = entries.find(key); found != entries.end()) {
+      recent.splice(recent.begin(), recent, found->second);
+      return found->second->query;
+    }
+    recent.push_front(Entry{language.impl, std::string{source}, compiled});
+    Entry& entry = recent.front();
+    entries.emplace(Key{entry.language, entry.source}, recent.begin());
+    while (recent.size() > capacity) {
+      Entry& oldest = recent.back();
+      entries.erase(Key{oldest.language, oldest.source});
+      recent.pop_back();
+      ++stats.evictions;
+    }
+    return compiled;
+  }
+
+  [[nodiscard]] QueryCacheStats
+  getStats() const {
+    std::lock_guard lock{mutex};
+    return stats;
+  }
+
+  [[nodiscard]] size_t
+  size() const {
+    std::lock_guard lock{mutex};
+    return recent.size();
+  }
+
+  void
+  clear() {
+    std::lock_guard lock{mutex};
+    entries.clear();
+    recent.clear();
+  }
+
+private:
+  struct Entry {
+    TSLanguage const* language;
+    std::string source;
+    std::shared_ptr<const Query> query;
+  };
+
+  // Keys view the source stored in their entry, which list nodes keep stable.
+  struct Key {
+    TSLanguage const* language;
+    std::string_view source;
+
+    bool operator==(const Key& other) const = default;
+  };
+
+  struct KeyHash {
+    size_t
+    operator()(const Key& key) const {
+      size_t hash = std::hash<std::string_view>{}(key.source);
+      return hash ^ (std::hash<TSLanguage const*>{}(key.language)
+                     + 0x9e3779b9 + (hash << 6) + (hash >> 2));
+    }
+  };
+
+  size_t capacity;
+  mutable std::mutex mutex;
+  std::list<Entry> recent;
+  std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> entries;
+  QueryCacheStats stats{};
+};
+
+
+}
+
+#endif
@@ -0,0 +1,720 @@
+#ifndef CPP_TREE_SITTER_QUERY_H
+#define CPP_TREE_SITTER_QUERY_H
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <ranges>
+#include <regex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <cpp-tree-sitter.h>
+
+// Queries and their text predicates pull in <regex>, so they live in their
+// own header rather than the core one.
+
+namespace ts {
+
+
+////////////////////////////////////////////////////////////////
+// Queries
+////////////////////////////////////////////////////////////////
+
+// Thrown when the source of a query fails to compile.
+class QueryCompilationError : public std::runtime_error {
+public:
+  QueryCompilationError(uint32_t offset, TSQueryError type)
+    : std::runtime_error{"Invalid tree-sitter query at offset "
+                         + std::to_string(offset)},
+      offset{offset},
+      type{type}
+      { }
+
+  // The byte offset within the query source at which the error was found.
+  [[nodiscard]] uint32_t
+  getOffset() const {
+    return offset;
+  }
+
+  [[nodiscard]] TSQueryError
+  getErrorType() const {
+    return type;
+  }
+
+private:
+  uint32_t offset;
+  TSQueryError type;
+};
+
+
+struct Capture {
+  Node node;
+  // The index of the capture name within the query.
+  uint32_t index;
+};
+
+
+// A single match of a query pattern. The captures of a match are only valid
+// until the cursor that produced it advances.
+struct Match {
+  explicit Match(const TSQueryMatch& match)
+    : impl{match}
+      { }
+
+  [[nodiscard]] uint32_t
+  getID() const {
+    return impl.id;
+  }
+
+  [[nodiscard]] uint32_t
+  getPatternIndex() const {
+    return impl.pattern_index;
+  }
+
+  [[nodiscard]] uint32_t
+  getNumCaptures() const {
+    return impl.capture_count;
+  }
+
+  [[nodiscard]] Capture
+  getCapture(uint32_t position) const {
+    const TSQueryCapture& capture = impl.captures[position];
+    return {Node{capture.node}, capture.index};
+  }
+
+  [[nodiscard]] auto
+  getCaptures() const {
+    return std::span{impl.captures, impl.capture_count}
+      | std::views::transform([](const TSQueryCapture& capture) {
+          return Capture{Node{capture.node}, capture.index};
+        });
+  }
+
+  TSQueryMatch impl;
+};
+
+
+// A compiled query. Compilation is expensive, so queries should be created
+// once and reused. A query is not modified by executing it, so a single query
+// may be shared by cursors on many threads and trees at once.
+//
+// The text predicates `#eq?`, `#match?`, and `#any-of?`, along with their
+// `not-` and `any-` variants, are compiled along with the query and are
+// applied by QueryCursor when it is given the source text of the tree.
+// Other predicates and directives are left to clients. Testing predicates
+// does not allocate, except for `#match?` patterns that are more than a
+// literal string with optional `^` and `$` anchors. Those are evaluated with
+// std::regex, which allocates on every evaluation.
+class Query {
+public:
+  // Throws QueryCompilationError if `source` is not a valid query or if a
+  // text predicate within it is malformed.
+  Query(Language language, std::string_view source)
+    : impl{compile(language, source), ts_query_delete} {
+    compilePredicates();
+  }
+
+  [[nodiscard]] uint32_t
+  getNumPatterns() const {
+    return ts_query_pattern_count(impl.get());
+  }
+
+  [[nodiscard]] uint32_t
+  getNumCaptures() const {
+    return ts_query_capture_count(impl.get());
+  }
+
+  [[nodiscard]] std::string_view
+  getCaptureName(uint32_t captureIndex) const {
+    uint32_t length = 0;
+    const char* name = ts_query_capture_name_for_id(impl.get(),
+                                                    captureIndex,
+                                                    &length);
+    return {name, length};
+  }
+
+  [[nodiscard]] uint32_t
+  getStartByteForPattern(uint32_t patternIndex) const {
+    return ts_query_start_byte_for_pattern(impl.get(), patternIndex);
+  }
+
+  // Disabling captures and patterns modifies the query, so it must not be
+  // done while the query is being executed.
+
+  void
+  disableCapture(std::string_view name) {
+    ts_query_disable_capture(impl.get(),
+                             name.data(),
+                             static_cast<uint32_t>(name.size()));
+  }
+
+  void
+  disablePattern(uint32_t patternIndex) {
+    ts_query_disable_pattern(impl.get(), patternIndex);
+  }
+
+  [[nodiscard]] bool
+  hasTextPredicates() const {
+    return !predicates.empty();
+  }
+
+  // Checks whether the captured text of `match` satisfies the text predicates
+  // of its pattern. Captured text is compared in place within `source`.
+  [[nodiscard]] bool
+  satisfiesPredicates(const Match& match, std::string_view source) const {
+    if (match.getPatternIndex() >= predicates.size()) {
+      return true;
+    }
+    for (const TextPredicate& predicate : predicates[match.getPatternIndex()]) {
+      if (!predicate.isSatisfied(match, source)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+private:
+  friend class QueryCursor;
+
+  struct TextPredicate {
+    enum class Kind {
+      EQ_STRING,
+      EQ_CAPTURE,
+      MATCH,
+      ANY_OF,
+      // Literal `#match?` patterns, which need no regex.
+      CONTAINS,
+      STARTS_WITH,
+      ENDS_WITH,
+    };
+
+    [[nodiscard]] bool
+    isSatisfied(const Match& match, std::string_view source) const {
+      if (kind == Kind::EQ_CAPTURE) {
+        // Captures are compared by their first nodes, if both are present.
+        auto first = findCapture(match, captureIndex);
+        auto second = findCapture(match, otherCaptureIndex);
+        if (!first || !second) {
+          return true;
+        }
+        return (first->getSourceRange(source) == second->getSourceRange(source))
+               == isPositive;
+      }
+
+      // Quantified captures may capture several nodes. By default all of them
+      // must satisfy the predicate, while `any-` variants need only one.
+      bool foundAny = false;
+      for (Capture capture : match.getCaptures()) {
+        if (capture.index != captureIndex) {
+          continue;
+        }
+        bool satisfied = test(capture.node.getSourceRange(source)) == isPositive;
+        if (matchAll && !satisfied) {
+          return false;
+        }
+        if (!matchAll && satisfied) {
+          return true;
+        }
+        foundAny = true;
+      }
+      return matchAll || !foundAny;
+    }
+
+    [[nodiscard]] bool
+    test(std::string_view text) const {
+      switch (kind) {
+        case Kind::EQ_STRING:
+          return text == value;
+        case Kind::MATCH:
+          return std::regex_search(text.begin(), text.end(), *pattern);
+        case Kind::ANY_OF:
+          return std::binary_search(values.begin(), values.end(), text);
+        case Kind::CONTAINS:
+          return text.find(value) != std::string_view::npos;
+        case Kind::STARTS_WITH:
+          return text.starts_with(value);
+        case Kind::ENDS_WITH:
+          return text.ends_with(value);
+        case Kind::EQ_CAPTURE:
+          break;
+      }
+      return false;
+    }
+
+    static std::optional<Node>
+    findCapture(const Match& match, uint32_t index) {
+      for (Capture capture : match.getCaptures()) {
+        if (capture.index == index) {
+          return capture.node;
+        }
+      }
+      return std::nullopt;
+    }
+
+    Kind kind;
+    bool isPositive;
+    bool matchAll;
+    uint32_t captureIndex;
+    uint32_t otherCaptureIndex;
+    // Strings view the string table of the query, which outlives them.
+    std::string_view value;
+    std::vector<std::string_view> values;
+    std::optional<std::regex> pattern;
+  };
+
+  [[nodiscard]] std::string_view
+  getStringValue(uint32_t stringIndex) const {
+    uint32_t length = 0;
+    const char* value = ts_query_string_value_for_id(impl.get(),
+                                                     stringIndex,
+                                                     &length);
+    return {value, length};
+  }
+
+  void
+  compilePredicates() {
+    uint32_t numPatterns = getNumPatterns();
+    for (uint32_t patternIndex = 0; patternIndex < numPatterns; ++patternIndex) {
+      uint32_t numSteps = 0;
+      const TSQueryPredicateStep* steps =
+        ts_query_predicates_for_pattern(impl.get(), patternIndex, &numSteps);
+
+      // Each predicate is a run of steps terminated by a Done step.
+      std::span<const TSQueryPredicateStep> remaining{steps, numSteps};
+      while (!remaining.empty()) {
+        auto done = std::find_if(remaining.begin(), remaining.end(),
+          [](const TSQueryPredicateStep& step) {
+            return step.type == TSQueryPredicateStepTypeDone;
+          });
+        std::span<const TSQueryPredicateStep> predicate{remaining.begin(), done};
+        remaining = remaining.subspan(
+          std::min(predicate.size() + 1, remaining.size()));
+        if (auto compiled = compilePredicate(patternIndex, predicate)) {
+          if (predicates.size() <= patternIndex) {
+            predicates.resize(numPatterns);
+          }
+          predicates[patternIndex].push_back(std::move(*compiled));
+        }
+      }
+    }
+  }
+
+  // Compiles a `#match?` pattern that is a literal string, optionally
+  // anchored, into a plain string comparison. Returns false for patterns
+  // that need a regex.
+  static bool
+  setLiteralMatch(TextPredicate& predicate, std::string_view regex) {
+    bool atStart = regex.starts_with('^');
+    if (atStart) {
+      regex.remove_prefix(1);
+    }
+    bool atEnd = regex.ends_with('$');
+    if (atEnd) {
+      regex.remove_suffix(1);
+    }
+    if (regex.find_first_of("\\^$.|?*+()[]{}") != std::string_view::npos) {
+      return false;
+    }
+    predicate.kind = atStart && atEnd ? TextPredicate::Kind::EQ_STRING
+                   : atStart          ? TextPredicate::Kind::STARTS_WITH
+                   : atEnd            ? TextPredicate::Kind::ENDS_WITH
+                   :                    TextPredicate::Kind::CONTAINS;
+    predicate.value = regex;
+    return true;
+  }
+
+  std::optional<TextPredicate>
+  compilePredicate(uint32_t patternIndex,
+                   std::span<const TSQueryPredicateStep> steps) const {
+    if (steps.empty() || steps[0].type != TSQueryPredicateStepTypeString) {
+      return std::nullopt;
+    }
+    std::string_view name = getStringValue(steps[0].value_id);
+    auto invalid = [this, patternIndex]() {
+      return QueryCompilationError{getStartByteForPattern(patternIndex),
+                                   TSQueryErrorStructure};
+    };
+
+    TextPredicate predicate{};
+    predicate.matchAll = !name.starts_with("any-") || name == "any-of?";
+    if (name.starts_with("any-") && name != "any-of?") {
+      name.remove_prefix(4);
+    }
+    predicate.isPositive = !name.starts_with("not-");
+    if (!predicate.isPositive) {
+      name.remove_prefix(4);
+    }
+
+    if (name == "eq?" || name == "match?") {
+      if (steps.size() != 3 || steps[1].type != TSQueryPredicateStepTypeCapture) {
+        throw invalid();
+      }
+      predicate.captureIndex = steps[1].value_id;
+      if (steps[2].type == TSQueryPredicateStepTypeCapture) {
+        if (name != "eq?") {
+          throw invalid();
+        }
+        predicate.kind = TextPredicate::Kind::EQ_CAPTURE;
+        predicate.otherCaptureIndex = steps[2].value_id;
+      } else if (name == "eq?") {
+        predicate.kind = TextPredicate::Kind::EQ_STRING;
+        predicate.value = getStringValue(steps[2].value_id);
+      } else {
+        std::string_view regex = getStringValue(steps[2].value_id);
+        if (setLiteralMatch(predicate, regex)) {
+          return predicate;
+        }
+        predicate.kind = TextPredicate::Kind::MATCH;
+        try {
+          predicate.pattern.emplace(regex.begin(), regex.end(),
+                                    std::regex::ECMAScript | std::regex::optimize);
+        } catch (const std::regex_error&) {
+          throw invalid();
+        }
+      }
+      return predicate;
+    }
+
+    if (name == "any-of?") {
+      if (steps.size() < 2 || steps[1].type != TSQueryPredicateStepTypeCapture) {
+        throw invalid();
+      }
+      predicate.kind = TextPredicate::Kind::ANY_OF;
+      predicate.captureIndex = steps[1].value_id;
+      for (const TSQueryPredicateStep& step : steps.subspan(2)) {
+        if (step.type != TSQueryPredicateStepTypeString) {
+          throw invalid();
+        }
+        predicate.values.push_back(getStringValue(step.value_id));
+      }
+      // Sorted once here so that matching is a binary search.
+      std::sort(predicate.values.begin(), predicate.values.end());
+      return predicate;
+    }
+
+    return std::nullopt;
+  }
+
+  static TSQuery*
+  compile(Language language, std::string_view source) {
+    uint32_t errorOffset = 0;
+    TSQueryError errorType = TSQueryErrorNone;
+    TSQuery* query = ts_query_new(language.impl,
+                                  source.data(),
+                                  static_cast<uint32_t>(source.size()),
+                                  &errorOffset,
+                                  &errorType);
+    if (!query) {
+      throw QueryCompilationError{errorOffset, errorType};
+    }
+    return query;
+  }
+
+  std::unique_ptr<TSQuery, decltype(&ts_query_delete)> impl;
+  // Text predicates indexed by pattern. Empty when no pattern has any.
+  std::vector<std::vector<TextPredicate>> predicates;
+};
+
+
+// Query match and capture iterators follow the same single pass model as the
+// child iterators below. Advancing an iterator advances the underlying cursor.
+
+class QueryIteratorSentinel { };
+
+class MatchIterator {
+public:
+  using value_type = ts::Match;
+  using difference_type = int;
+  using iterator_category = std::input_iterator_tag;
+
+  // When `query` is provided, matches that do not satisfy its text
+  // predicates over `source` are skipped.
+  explicit MatchIterator(TSQueryCursor* cursor,
+                         const Query* query = nullptr,
+                         std::string_view source = {})
+    : cursor{cursor},
+      query{query},
+      source{source},
+      match{},
+      atEnd{false} {
+    advance();
+  }
+
+  value_type
+  operator*() const {
+    return Match{match};
+  }
+
+  MatchIterator&
+  operator++() {
+    advance();
+    return *this;
+  }
+
+  MatchIterator&
+  operator++(int) {
+    advance();
+    return *this;
+  }
+
+  friend bool operator== (const MatchIterator& a, const QueryIteratorSentinel&)   { return a.atEnd; }
+  friend bool operator!= (const MatchIterator& a, const QueryIteratorSentinel& b) { return !(a == b); }
+  friend bool operator== (const QueryIteratorSentinel& b, const MatchIterator& a) { return a == b; }
+  friend bool operator!= (const QueryIteratorSentinel& b, const MatchIterator& a) { return a != b; }
+
+private:
+  void
+  advance() {
+    do {
+      atEnd = !ts_query_cursor_next_match(cursor, &match);
+    } while (!atEnd && query && !query->satisfiesPredicates(Match{match}, source));
+  }
+
+  TSQueryCursor* cursor;
+  const Query* query;
+  std::string_view source;
+  TSQueryMatch match;
+  bool atEnd;
+};
+
+
+// Iterates over the captures of all matches in the order that the captured
+// nodes appear in the tree.
+class CaptureIterator {
+public:
+  using value_type = ts::Capture;
+  using difference_type = int;
+  using iterator_category = std::input_iterator_tag;
+
+  // When `query` is provided, captures of matches that do not satisfy its
+  // text predicates over `source` are skipped.
+  explicit CaptureIterator(TSQueryCursor* cursor,
+                           const Query* query = nullptr,
+                           std::string_view source = {})
+    : cursor{cursor},
+      query{query},
+      source{source},
+      match{},
+      captureIndex{0},
+      acceptedMatchID{std::nullopt},
+      atEnd{false} {
+    advance();
+  }
+
+  value_type
+  operator*() const {
+    return Match{match}.getCapture(captureIndex);
+  }
+
+  CaptureIterator&
+  operator++() {
+    advance();
+    return *this;
+  }
+
+  CaptureIterator&
+  operator++(int) {
+    advance();
+    return *this;
+  }
+
+  friend bool operator== (const CaptureIterator& a, const QueryIteratorSentinel&)   { return a.atEnd; }
+  friend bool operator!= (const CaptureIterator& a, const QueryIteratorSentinel& b) { return !(a == b); }
+  friend bool operator== (const QueryIteratorSentinel& b, const CaptureIterator& a) { return a == b; }
+  friend bool operator!= (const QueryIteratorSentinel& b, const CaptureIterator& a) { return a != b; }
+
+private:
+  void
+  advance() {
+    while (true) {
+      atEnd = !ts_query_cursor_next_capture(cursor, &match, &captureIndex);
+      if (atEnd || !query || acceptedMatchID == match.id) {
+        return;
+      }
+      // Each match yields several captures, so remember the last match that
+      // passed its predicates instead of evaluating them once per capture.
+      if (query->satisfiesPredicates(Match{match}, source)) {
+        acceptedMatchID = match.id;
+        return;
+      }
+      ts_query_cursor_remove_match(cursor, match.id);
+    }
+  }
+
+  TSQueryCursor* cursor;
+  const Query* query;
+  std::string_view source;
+  TSQueryMatch match;
+  uint32_t captureIndex;
+  std::optional<uint32_t> acceptedMatchID;
+  bool atEnd;
+};
+
+
+struct Matches {
+  using iterator = MatchIterator;
+  using sentinel = QueryIteratorSentinel;
+
+  auto begin() const -> iterator { return MatchIterator{cursor, query, source}; }
+  auto end() const -> sentinel { return {}; }
+  TSQueryCursor* cursor;
+  const Query* query = nullptr;
+  std::string_view source = {};
+};
+
+
+struct Captures {
+  using iterator = CaptureIterator;
+  using sentinel = QueryIteratorSentinel;
+
+  auto begin() const -> iterator { return CaptureIterator{cursor, query, source}; }
+  auto end() const -> sentinel { return {}; }
+  TSQueryCursor* cursor;
+  const Query* query = nullptr;
+  std::string_view source = {};
+};
+
+static_assert(std::input_iterator<MatchIterator>);
+static_assert(std::sentinel_for<QueryIteratorSentinel, MatchIterator>);
+static_assert(std::input_iterator<CaptureIterator>);
+static_assert(std::sentinel_for<QueryIteratorSentinel, CaptureIterator>);
+
+
+// Executes queries over trees. A cursor holds the state of a single
+// execution, so each thread needs its own cursor, but a cursor may be reused
+// for any number of executions.
+class QueryCursor {
+public:
+  QueryCursor()
+    : impl{ts_query_cursor_new(), ts_query_cursor_delete}
+      { }
+
+  // Restricts subsequent executions to nodes intersecting the given range.
+
+  void
+  setByteRange(Extent<uint32_t> range) {
+    ts_query_cursor_set_byte_range(impl.get(), range.start, range.end);
+  }
+
+  void
+  setPointRange(Extent<Point> range) {
+    ts_query_cursor_set_point_range(impl.get(), range.start, range.end);
+  }
+
+  void
+  setMatchLimit(uint32_t limit) {
+    ts_query_cursor_set_match_limit(impl.get(), limit);
+  }
+
+  [[nodiscard]] bool
+  didExceedMatchLimit() const {
+    return ts_query_cursor_did_exceed_match_limit(impl.get());
+  }
+
+  // Starts executing `query` on the subtree rooted at `node` and returns the
+  // matches found. The query and tree must outlive the iteration, and
+  // executing the cursor again invalidates any earlier results.
+  [[nodiscard]] Matches
+  exec(const Query& query, Node node) {
+    ts_query_cursor_exec(impl.get(), query.impl.get(), node.impl);
+    return Matches{impl.get()};
+  }
+
+  // As exec, but only yields matches satisfying the text predicates of
+  // `query`, evaluated against `source`, the text that the tree was parsed
+  // from. `source` must outlive the iteration.
+  [[nodiscard]] Matches
+  exec(const Query& query, Node node, std::string_view source) {
+    ts_query_cursor_exec(impl.get(), query.impl.get(), node.impl);
+    return Matches{impl.get(), query.hasTextPredicates() ? &query : nullptr, source};
+  }
+
+  // As exec, but yields individual captures in tree order.
+  [[nodiscard]] Captures
+  execCaptures(const Query& query, Node node) {
+    ts_query_cursor_exec(impl.get(), query.impl.get(), node.impl);
+    return Captures{impl.get()};
+  }
+
+  [[nodiscard]] Captures
+  execCaptures(const Query& query, Node node, std::string_view source) {
+    ts_query_cursor_exec(impl.get(), query.impl.get(), node.impl);
+    return Captures{impl.get(), query.hasTextPredicates() ? &query : nullptr, source};
+  }
+
+private:
+  std::unique_ptr<TSQueryCursor, decltype(&ts_query_cursor_delete)> impl;
+};
+
+
+
+////////////////////////////////////////////////////////////////
+// Language injection
+////////////////////////////////////////////////////////////////
+
+// Collects the ranges of the nodes within `node` captured as `captureName` by
+// `query`, in the sorted, non-overlapping form that Parser::setIncludedRanges
+// requires. Captures nested within earlier captures are dropped.
+[[nodiscard]] inline std::vector<Range>
+collectCapturedRanges(const Query& query,
+                      Node node,
+                      std::string_view source,
+                      std::string_view captureName) {
+  std::vector<Range> ranges;
+  QueryCursor cursor;
+  for (Capture capture : cursor.execCaptures(query, node, source)) {
+    if (query.getCaptureName(capture.index) == captureName) {
+      ranges.push_back(capture.node.getRange());
+    }
+  }
+  std::stable_sort(ranges.begin(), ranges.end(),
+    [](const Range& a, const Range& b) { return a.start_byte < b.start_byte; });
+  size_t kept = 0;
+  for (const Range& range : ranges) {
+    if (kept == 0 || range.start_byte >= ranges[kept - 1].end_byte) {
+      ranges[kept++] = range;
+    }
+  }
+  ranges.resize(kept);
+  return ranges;
+}
+
+
+// Parses the regions of `source` that `query` captures as `captureName`
+// within `outer`, following tree-sitter's injection query convention, with
+// `parser` and its language. The regions are parsed in place within
+// `source`, so no text is copied and positions in the resulting tree are
+// relative to all of `source`. Returns nothing if no regions were captured
+// or if the parser's timeout or cancellation token stopped the parse, in
+// which case the parser is reset rather than left to resume the stopped
+// parse. The parser is left without included ranges afterward.
+[[nodiscard]] inline std::optional<Tree>
+parseInjection(Parser& parser,
+               const Query& query,
+               Node outer,
+               std::string_view source,
+               std::string_view captureName = "injection.content") {
+  std::vector<Range> ranges =
+    collectCapturedRanges(query, outer, source, captureName);
+  if (ranges.empty() || !parser.setIncludedRanges(ranges)) {
+    return std::nullopt;
+  }
+  std::optional<Tree> tree = parser.tryParseString(source);
+  if (!tree) {
+    parser.reset();
+  }
+  [[maybe_unused]] bool cleared = parser.setIncludedRanges({});
+  return tree;
+}
+
+
+}
+
+#endif
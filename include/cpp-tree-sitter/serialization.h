@@ -0,0 +1,296 @@
+#ifndef CPP_TREE_SITTER_SERIALIZATION_H
+#define CPP_TREE_SITTER_SERIALIZATION_H
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include <cpp-tree-sitter.h>
+#include <cpp-tree-sitter/flat-tree.h>
+#include <cpp-tree-sitter/mapped-source.h>
+
+// Saved trees use the FlatTree layout directly: a fixed size header followed
+// by each column as a fixed width array. Loading a tree maps the file and
+// views the columns in place, so a loaded tree is navigable without decoding.
+// Files use the byte order of the machine that wrote them; files from a
+// machine with a different byte order are rejected when loading.
+
+namespace ts {
+
+
+// A 64 bit FNV-1a hash of source text, used to detect whether a saved tree
+// is still current for its source.
+[[nodiscard]] inline uint64_t
+hashContent(std::string_view content) {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (char c : content) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+
+namespace detail {
+
+inline constexpr char SAVED_TREE_MAGIC[4] = {'T', 'S', 'F', 'T'};
+inline constexpr uint32_t SAVED_TREE_FORMAT_VERSION = 1;
+
+struct SavedTreeHeader {
+  char magic[4];
+  uint32_t formatVersion;
+  uint32_t languageVersion;
+  uint32_t numSymbols;
+  uint32_t numFields;
+  uint32_t numNodes;
+  uint64_t contentHash;
+};
+
+// Byte offsets of each column within a saved tree. Columns are aligned to
+// 8 bytes so that they can be viewed in place within a mapping.
+struct SavedTreeLayout {
+  explicit SavedTreeLayout(size_t numNodes) {
+    size_t offset = sizeof(SavedTreeHeader);
+    auto place = [&offset, numNodes](size_t elementSize) {
+      size_t start = (offset + 7) & ~size_t{7};
+      offset = start + elementSize * numNodes;
+      return start;
+    };
+    symbols = place(sizeof(Symbol));
+    fieldIDs = place(sizeof(FieldID));
+    flags = place(sizeof(uint8_t));
+    startBytes = place(sizeof(uint32_t));
+    endBytes = place(sizeof(uint32_t));
+    parents = place(sizeof(FlatTree::Index));
+    firstChildren = place(sizeof(FlatTree::Index));
+    nextSiblings = place(sizeof(FlatTree::Index));
+    subtreeEnds = place(sizeof(FlatTree::Index));
+    size = offset;
+  }
+
+  size_t symbols;
+  size_t fieldIDs;
+  size_t flags;
+  size_t startBytes;
+  size_t endBytes;
+  size_t parents;
+  size_t firstChildren;
+  size_t nextSiblings;
+  size_t subtreeEnds;
+  size_t size;
+};
+
+template <typename T>
+std::span<const T>
+viewColumn(const char* start, size_t count) {
+  return {reinterpret_cast<const T*>(start), count};
+}
+
+// Checks that every symbol belongs to the language and that the links
+// between nodes are consistent with the preorder layout that FlatTree
+// builds, so that navigating a loaded tree can neither index past its
+// columns, loop forever, nor look up the name of an unknown symbol.
+[[nodiscard]] inline bool
+hasValidNodes(const FlatTree::Columns& columns, uint32_t count, uint32_t numSymbols) {
+  constexpr FlatTree::Index NONE = FlatTree::NONE;
+  for (uint32_t i = 0; i < count; ++i) {
+    // ERROR nodes use tree-sitter's builtin error symbol, which lies outside
+    // the language's own symbols.
+    Symbol symbol = columns.symbols[i];
+    if (symbol >= numSymbols && symbol != static_cast<Symbol>(-1)) {
+      return false;
+    }
+    FlatTree::Index parent = columns.parents[i];
+    FlatTree::Index firstChild = columns.firstChildren[i];
+    FlatTree::Index nextSibling = columns.nextSiblings[i];
+    FlatTree::Index subtreeEnd = columns.subtreeEnds[i];
+    if ((parent != NONE && parent >= i)
+        || (firstChild != NONE && firstChild != i + 1)
+        || (nextSibling != NONE && (nextSibling <= i || nextSibling >= count))
+        || subtreeEnd <= i || subtreeEnd > count) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}
+
+
+// Writes `tree` to `out`, recording `contentHash` (see hashContent) so that
+// a stale tree can be detected when loading.
+inline void
+saveTree(const FlatTree& tree, std::ostream& out, uint64_t contentHash) {
+  Language language = tree.getLanguage();
+  detail::SavedTreeHeader header{
+    {},
+    detail::SAVED_TREE_FORMAT_VERSION,
+    language.getVersion(),
+    static_cast<uint32_t>(language.getNumSymbols()),
+    static_cast<uint32_t>(language.getNumFields()),
+    static_cast<uint32_t>(tree.size()),
+    contentHash
+  };
+  std::memcpy(header.magic, detail::SAVED_TREE_MAGIC, sizeof(header.magic));
+
+  detail::SavedTreeLayout layout{tree.size()};
+  size_t written = 0;
+  auto writeAt = [&out, &written](size_t offset, const void* data, size_t size) {
+    static constexpr char padding[8] = {};
+    out.write(padding, static_cast<std::streamsize>(offset - written));
+    out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+    written = offset + size;
+  };
+  auto writeColumn = [&writeAt](size_t offset, auto column) {
+    writeAt(offset, column.data(), column.size_bytes());
+  };
+
+  writeAt(0, &header, sizeof(header));
+  writeColumn(layout.symbols, tree.getSymbols());
+  writeColumn(layout.fieldIDs, tree.getFieldIDs());
+  writeColumn(layout.flags, tree.getFlags());
+  writeColumn(layout.startBytes, tree.getStartBytes());
+  writeColumn(layout.endBytes, tree.getEndBytes());
+  writeColumn(layout.parents, tree.getParents());
+  writeColumn(layout.firstChildren, tree.getFirstChildren());
+  writeColumn(layout.nextSiblings, tree.getNextSiblings());
+  writeColumn(layout.subtreeEnds, tree.getSubtreeEnds());
+}
+
+
+// Throws std::ios_base::failure if the file cannot be written.
+inline void
+saveTree(const FlatTree& tree,
+         const std::filesystem::path& path,
+         uint64_t contentHash) {
+  std::ofstream out;
+  out.exceptions(std::ios::failbit | std::ios::badbit);
+  out.open(path, std::ios::binary | std::ios::trunc);
+  saveTree(tree, out, contentHash);
+}
+
+
+// Views a saved tree within `source`, which is kept alive by the resulting
+// tree. Returns nothing if the saved tree is malformed, was saved for a
+// different grammar or version of `language`, or does not match
+// `expectedHash`. Symbols and the links between nodes are checked while
+// loading, so a corrupt file cannot make navigation read past the columns or
+// ask the language for the name of a symbol it does not have.
+[[nodiscard]] inline std::optional<FlatTree>
+loadTree(std::shared_ptr<const MappedSource> source,
+         Language language,
+         uint64_t expectedHash) {
+  std::string_view bytes = source->getContents();
+  detail::SavedTreeHeader header;
+  if (bytes.size() < sizeof(header)) {
+    return std::nullopt;
+  }
+  std::memcpy(&header, bytes.data(), sizeof(header));
+  if (std::memcmp(header.magic, detail::SAVED_TREE_MAGIC, sizeof(header.magic)) != 0
+      || header.formatVersion != detail::SAVED_TREE_FORMAT_VERSION
+      || header.languageVersion != language.getVersion()
+      || header.numSymbols != language.getNumSymbols()
+      || header.numFields != language.getNumFields()
+      || header.contentHash != expectedHash) {
+    return std::nullopt;
+  }
+  detail::SavedTreeLayout layout{header.numNodes};
+  if (bytes.size() < layout.size) {
+    return std::nullopt;
+  }
+
+  auto base = bytes.data();
+  uint32_t count = header.numNodes;
+  FlatTree::Columns columns{
+    detail::viewColumn<Symbol>(base + layout.symbols, count),
+    detail::viewColumn<FieldID>(base + layout.fieldIDs, count),
+    detail::viewColumn<uint8_t>(base + layout.flags, count),
+    detail::viewColumn<uint32_t>(base + layout.startBytes, count),
+    detail::viewColumn<uint32_t>(base + layout.endBytes, count),
+    detail::viewColumn<FlatTree::Index>(base + layout.parents, count),
+    detail::viewColumn<FlatTree::Index>(base + layout.firstChildren, count),
+    detail::viewColumn<FlatTree::Index>(base + layout.nextSiblings, count),
+    detail::viewColumn<FlatTree::Index>(base + layout.subtreeEnds, count),
+  };
+  if (!detail::hasValidNodes(columns, count, header.numSymbols)) {
+    return std::nullopt;
+  }
+  return FlatTree{language, columns, std::move(source)};
+}
+
+
+// Maps and views the saved tree at `path`. Returns nothing if the file does
+// not exist or cannot be used, as above. Throws std::system_error for other
+// failures to map the file.
+[[nodiscard]] inline std::optional<FlatTree>
+loadTree(const std::filesystem::path& path,
+         Language language,
+         uint64_t expectedHash) {
+  std::shared_ptr<const MappedSource> source;
+  try {
+    source = std::make_shared<const MappedSource>(path);
+  } catch (const std::system_error& error) {
+    if (error.code() == std::errc::no_such_file_or_directory) {
+      return std::nullopt;
+    }
+    throw;
+  }
+  return loadTree(std::move(source), language, expectedHash);
+}
+
+
+// A directory of saved trees keyed by the hash of their source text. Sources
+// that have been seen before are loaded from the cache instead of parsed.
+// Each grammar should use its own directory. Entries are written to a
+// temporary file and then renamed into place, so several processes may
+// share a cache directory.
+class ParseCache {
+public:
+  explicit ParseCache(std::filesystem::path directory)
+    : directory{std::move(directory)} {
+    std::filesystem::create_directories(this->directory);
+  }
+
+  [[nodiscard]] FlatTree
+  get(Parser& parser, std::string_view source) {
+    uint64_t hash = hashContent(source);
+    std::filesystem::path path = getPath(hash);
+    if (auto cached = loadTree(path, parser.getLanguage(), hash)) {
+      return std::move(*cached);
+    }
+
+    FlatTree flat = FlatTree::build(parser.parseString(source));
+    std::filesystem::path temporary = path;
+    temporary += ".tmp" + std::to_string(std::random_device{}());
+    saveTree(flat, temporary, hash);
+    std::filesystem::rename(temporary, path);
+    return flat;
+  }
+
+  [[nodiscard]] std::filesystem::path
+  getPath(uint64_t contentHash) const {
+    static constexpr char digits[] = "0123456789abcdef";
+    std::string name(16, '0');
+    for (size_t i = 0; i < 16; ++i) {
+      name[15 - i] = digits[(contentHash >> (4 * i)) & 0xf];
+    }
+    return directory / (name + ".tsft");
+  }
+
+private:
+  std::filesystem::path directory;
+};
+
+
+}
+
+#endif
@@ -0,0 +1,358 @@
+#ifndef CPP_TREE_SITTER_TREE_WRITER_H
+#define CPP_TREE_SITTER_TREE_WRITER_H
+
+#include <algorithm>
+#include <charconv>
+#include <concepts>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+
+#include <cpp-tree-sitter.h>
+
+// Streaming alternatives to Node::getSExpr. Rather than building the whole
+// text in one allocation, these walk the tree with a single cursor and hand
+// the text to a sink a piece at a time. A sink may be
+// * any callable accepting a std::string_view,
+// * an output iterator of char, such as a std::back_insert_iterator,
+// * a FILE*, checked with std::ferror afterward, or
+// * a ChunkedWriter, which batches text into a fixed buffer.
+
+namespace ts {
+
+
+template <typename T>
+concept TextSink = std::invocable<T&, std::string_view>;
+
+
+// Collects text into `buffer`, passing it to `flush` each time the buffer
+// fills. Call flush() once writing is done to pass along any remaining text.
+template <typename Flush>
+requires std::invocable<Flush&, std::string_view>
+class ChunkedWriter {
+public:
+  ChunkedWriter(std::span<char> buffer, Flush onFlush)
+    : buffer{buffer},
+      onFlush{std::move(onFlush)} {
+    if (buffer.empty()) {
+      throw std::invalid_argument{"ChunkedWriter requires a nonempty buffer"};
+    }
+  }
+
+  void
+  operator()(std::string_view text) {
+    while (!text.empty()) {
+      size_t count = std::min(text.size(), buffer.size() - used);
+      std::memcpy(buffer.data() + used, text.data(), count);
+      used += count;
+      text.remove_prefix(count);
+      if (used == buffer.size()) {
+        flush();
+      }
+    }
+  }
+
+  void
+  flush() {
+    if (used > 0) {
+      onFlush(std::string_view{buffer.data(), used});
+      used = 0;
+    }
+  }
+
+private:
+  std::span<char> buffer;
+  Flush onFlush;
+  size_t used = 0;
+};
+
+
+namespace detail {
+
+enum class WritePosition {
+  ROOT,
+  FIRST_CHILD,
+  NEXT_SIBLING,
+};
+
+// Walks the subtree below `root` in preorder with a single cursor. `enter`
+// receives the cursor and the position of the node among its siblings.
+// `leave` receives the cursor and whether the node had any children.
+template <typename Enter, typename Leave>
+void
+walkForWriting(Node root, Enter&& enter, Leave&& leave) {
+  Cursor cursor = root.getCursor();
+  enter(cursor, WritePosition::ROOT);
+  while (true) {
+    if (cursor.gotoFirstChild()) {
+      enter(cursor, WritePosition::FIRST_CHILD);
+      continue;
+    }
+    leave(cursor, false);
+    while (!cursor.gotoNextSibling()) {
+      if (!cursor.gotoParent()) {
+        return;
+      }
+      leave(cursor, true);
+    }
+    enter(cursor, WritePosition::NEXT_SIBLING);
+  }
+}
+
+template <TextSink Sink>
+void
+writeNumber(Sink& sink, uint32_t value) {
+  char digits[10];
+  auto [end, error] = std::to_chars(std::begin(digits), std::end(digits), value);
+  sink(std::string_view{digits, static_cast<size_t>(end - digits)});
+}
+
+template <TextSink Sink>
+void
+writeJSONString(Sink& sink, std::string_view text) {
+  static constexpr char HEX[] = "0123456789abcdef";
+  sink("\"");
+  size_t plain = 0;
+  for (size_t i = 0; i < text.size(); ++i) {
+    auto c = static_cast<unsigned char>(text[i]);
+    if (c >= 0x20 && c != '"' && c != '\\') {
+      continue;
+    }
+    sink(text.substr(plain, i - plain));
+    plain = i + 1;
+    if (c == '"' || c == '\\') {
+      char escaped[2] = {'\\', static_cast<char>(c)};
+      sink(std::string_view{escaped, 2});
+    } else {
+      char escaped[6] = {'\\', 'u', '0', '0', HEX[c >> 4], HEX[c & 0xf]};
+      sink(std::string_view{escaped, 6});
+    }
+  }
+  sink(text.substr(plain));
+  sink("\"");
+}
+
+// Writes the first character of `text` as ts_node_string does for the
+// unexpected character of an error.
+template <TextSink Sink>
+void
+writeUnexpectedChar(Sink& sink, std::string_view text) {
+  auto byte = [text](size_t i) { return static_cast<uint8_t>(text[i]); };
+  uint8_t first = byte(0);
+  size_t length = first < 0x80 ? 1
+                : (first & 0xe0) == 0xc0 ? 2
+                : (first & 0xf0) == 0xe0 ? 3
+                : (first & 0xf8) == 0xf0 ? 4
+                : 0;
+  if (length == 0 || length > text.size()) {
+    sink("INVALID");
+    return;
+  }
+  uint32_t code = length == 1 ? first : first & (0x7fu >> length);
+  for (size_t i = 1; i < length; ++i) {
+    if ((byte(i) & 0xc0) != 0x80) {
+      sink("INVALID");
+      return;
+    }
+    code = (code << 6) | (byte(i) & 0x3fu);
+  }
+  switch (code) {
+    case '\0': sink("'\\0'"); return;
+    case '\n': sink("'\\n'"); return;
+    case '\t': sink("'\\t'"); return;
+    case '\r': sink("'\\r'"); return;
+    default: break;
+  }
+  if (code >= 0x20 && code < 0x7f) {
+    char quoted[3] = {'\'', static_cast<char>(code), '\''};
+    sink(std::string_view{quoted, 3});
+  } else {
+    writeNumber(sink, code);
+  }
+}
+
+template <TextSink Sink>
+void
+writeSExprTo(Node node, Sink& sink, std::optional<std::string_view> source) {
+  // Like ts_node_string, only named and missing nodes are written.
+  auto isWritten = [](Node current) {
+    return current.isNamed() || current.isMissing();
+  };
+  auto enter = [&sink, &isWritten, source](const Cursor& cursor,
+                                          WritePosition position) {
+    Node current = cursor.getCurrentNode();
+    if (!isWritten(current)) {
+      return;
+    }
+    if (position != WritePosition::ROOT) {
+      sink(" ");
+      if (std::string_view field = cursor.getCurrentFieldName(); !field.empty()) {
+        sink(field);
+        sink(": ");
+      }
+    }
+    sink("(");
+    Extent<uint32_t> range = current.getByteRange();
+    if (source && current.isError() && current.getNumChildren() == 0
+        && range.start < range.end && range.end <= source->size()) {
+      sink("UNEXPECTED ");
+      writeUnexpectedChar(sink, source->substr(range.start));
+      return;
+    }
+    if (current.isMissing()) {
+      sink("MISSING ");
+      if (!current.isNamed()) {
+        sink("\"");
+        sink(current.getType());
+        sink("\"");
+        return;
+      }
+    }
+    sink(current.getType());
+  };
+  auto leave = [&sink, &isWritten](const Cursor& cursor, bool) {
+    if (isWritten(cursor.getCurrentNode())) {
+      sink(")");
+    }
+  };
+  walkForWriting(node, enter, leave);
+}
+
+template <TextSink Sink>
+void
+writeJSONTo(Node node, Sink& sink) {
+  auto enter = [&sink](const Cursor& cursor, WritePosition position) {
+    if (position == WritePosition::FIRST_CHILD) {
+      sink(",\"children\":[");
+    } else if (position == WritePosition::NEXT_SIBLING) {
+      sink(",");
+    }
+    Node current = cursor.getCurrentNode();
+    sink("{\"type\":");
+    writeJSONString(sink, current.getType());
+    sink(current.isNamed() ? ",\"named\":true" : ",\"named\":false");
+    if (current.isMissing()) {
+      sink(",\"missing\":true");
+    }
+    if (std::string_view field = cursor.getCurrentFieldName(); !field.empty()) {
+      sink(",\"field\":");
+      writeJSONString(sink, field);
+    }
+    Extent<uint32_t> range = current.getByteRange();
+    sink(",\"startByte\":");
+    writeNumber(sink, range.start);
+    sink(",\"endByte\":");
+    writeNumber(sink, range.end);
+  };
+  auto leave = [&sink](const Cursor&, bool hadChildren) {
+    sink(hadChildren ? "]}" : "}");
+  };
+  walkForWriting(node, enter, leave);
+}
+
+inline void
+writeToFile(std::FILE* file, std::string_view text) {
+  std::fwrite(text.data(), 1, text.size(), file);
+}
+
+}
+
+
+////////////////////////////////////////////////////////////////
+// S-expressions
+////////////////////////////////////////////////////////////////
+
+// Writes the text of Node::getSExpr, except that an error containing only
+// an unexpected character is written as (ERROR) rather than as
+// (UNEXPECTED 'c'). tree-sitter does not expose that character; pass the
+// source to the overloads below to write it as getSExpr does.
+template <TextSink Sink>
+void
+writeSExpr(Node node, Sink&& sink) {
+  detail::writeSExprTo(node, sink, std::nullopt);
+}
+
+template <std::output_iterator<char> Out>
+requires (!TextSink<Out>)
+Out
+writeSExpr(Node node, Out out) {
+  auto sink = [&out](std::string_view text) {
+    out = std::copy(text.begin(), text.end(), out);
+  };
+  detail::writeSExprTo(node, sink, std::nullopt);
+  return out;
+}
+
+inline void
+writeSExpr(Node node, std::FILE* file) {
+  auto sink = [file](std::string_view text) { detail::writeToFile(file, text); };
+  detail::writeSExprTo(node, sink, std::nullopt);
+}
+
+// Writes the same text as Node::getSExpr, reading unexpected characters from
+// `source`, the text that the tree was parsed from.
+template <TextSink Sink>
+void
+writeSExpr(Node node, std::string_view source, Sink&& sink) {
+  detail::writeSExprTo(node, sink, source);
+}
+
+template <std::output_iterator<char> Out>
+requires (!TextSink<Out>)
+Out
+writeSExpr(Node node, std::string_view source, Out out) {
+  auto sink = [&out](std::string_view text) {
+    out = std::copy(text.begin(), text.end(), out);
+  };
+  detail::writeSExprTo(node, sink, source);
+  return out;
+}
+
+inline void
+writeSExpr(Node node, std::string_view source, std::FILE* file) {
+  auto sink = [file](std::string_view text) { detail::writeToFile(file, text); };
+  detail::writeSExprTo(node, sink, source);
+}
+
+
+////////////////////////////////////////////////////////////////
+// JSON
+////////////////////////////////////////////////////////////////
+
+// Writes every node, named or not, as an object of the form
+//   {"type":"pair","named":true,"field":"value","startByte":1,"endByte":9,
+//    "children":[...]}
+// where "field" is present only for nodes in a field, "children" only for
+// nodes with children, and "missing":true is added for missing nodes.
+template <TextSink Sink>
+void
+writeJSON(Node node, Sink&& sink) {
+  detail::writeJSONTo(node, sink);
+}
+
+template <std::output_iterator<char> Out>
+requires (!TextSink<Out>)
+Out
+writeJSON(Node node, Out out) {
+  auto sink = [&out](std::string_view text) {
+    out = std::copy(text.begin(), text.end(), out);
+  };
+  detail::writeJSONTo(node, sink);
+  return out;
+}
+
+inline void
+writeJSON(Node node, std::FILE* file) {
+  auto sink = [file](std::string_view text) { detail::writeToFile(file, text); };
+  detail::writeJSONTo(node, sink);
+}
+
+
+}
+
+#endif